@@ -6,7 +6,7 @@
 %global user_module_dir %{mydatarootdir}/qore-modules/
 
 Name:           qore-v8-module
-Version:        1.0.0
+Version:        1.1.0
 Release:        1
 Summary:        Qorus Integration Engine - Qore v8 module
 License:        MIT
@@ -69,5 +69,8 @@ This RPM provides API documentation, test and example programs
 %doc docs/v8 test/*.qtest
 
 %changelog
+* Sat Oct 17 2026 David Nichols <david@qore.org>
+- updated to version 1.1.0
+
 * Thu Jul 25 2024 David Nichols <david@qore.org>
 - initial version
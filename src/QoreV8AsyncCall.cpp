@@ -0,0 +1,127 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+
+#include "QoreV8AsyncCall.h"
+#include "QoreV8Program.h"
+
+// the maximum number of worker threads
+static constexpr unsigned QV8_ASYNC_MAX_THREADS = 32;
+// the time in milliseconds after which idle worker threads exit
+static constexpr int QV8_ASYNC_IDLE_MS = 10000;
+
+QoreThreadLock QoreV8AsyncWorkerPool::m;
+QoreCondition QoreV8AsyncWorkerPool::cond;
+std::deque<QoreV8AsyncCall*> QoreV8AsyncWorkerPool::queue;
+unsigned QoreV8AsyncWorkerPool::threads = 0;
+unsigned QoreV8AsyncWorkerPool::idle = 0;
+bool QoreV8AsyncWorkerPool::stop = false;
+
+QoreV8AsyncCall::QoreV8AsyncCall(QoreV8Program* pgm, int64 id, ResolvedCallReferenceNode* code,
+        QoreListNode* args) : pgm(pgm), id(id), code(code), args(args) {
+    pgm->weakRef();
+}
+
+QoreV8AsyncCall::~QoreV8AsyncCall() {
+    assert(!code);
+    assert(!args);
+    assert(!rv);
+    pgm->weakDeref();
+}
+
+void QoreV8AsyncCall::release(ExceptionSink* xsink) {
+    if (code) {
+        code->deref(xsink);
+        code = nullptr;
+    }
+    if (args) {
+        args->deref(xsink);
+        args = nullptr;
+    }
+    rv.discard(xsink);
+    rv = QoreValue();
+}
+
+void QoreV8AsyncCall::run() {
+    ValueHolder v(code->execValue(args, &xsink), &xsink);
+    if (!xsink) {
+        rv = v.release();
+    }
+    // release the call and arguments in the worker thread
+    code->deref(&xsink);
+    code = nullptr;
+    if (args) {
+        args->deref(&xsink);
+        args = nullptr;
+    }
+}
+
+int QoreV8AsyncWorkerPool::submit(ExceptionSink* xsink, QoreV8AsyncCall* call) {
+    AutoLocker al(m);
+    if (stop) {
+        xsink->raiseException("JAVASCRIPT-ASYNC-ERROR", "the v8 module is shutting down");
+        return -1;
+    }
+    queue.push_back(call);
+    if (idle) {
+        cond.signal();
+        return 0;
+    }
+    if (threads < QV8_ASYNC_MAX_THREADS) {
+        ++threads;
+        if (q_start_thread(xsink, worker_thread, nullptr) < 0) {
+            --threads;
+            // the call can be run by an existing thread
+            if (threads) {
+                xsink->clear();
+            } else {
+                queue.pop_back();
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+void QoreV8AsyncWorkerPool::shutdown() {
+    std::deque<QoreV8AsyncCall*> discard;
+    {
+        AutoLocker al(m);
+        stop = true;
+        discard.swap(queue);
+        cond.broadcast();
+        while (threads) {
+            cond.wait(&m);
+        }
+    }
+    ExceptionSink xsink;
+    for (QoreV8AsyncCall* call : discard) {
+        call->release(&xsink);
+        delete call;
+    }
+}
+
+void QoreV8AsyncWorkerPool::worker_thread(ExceptionSink* xsink, void* arg) {
+    AutoLocker al(m);
+    while (true) {
+        while (queue.empty() && !stop) {
+            ++idle;
+            int rc = cond.wait(&m, QV8_ASYNC_IDLE_MS);
+            --idle;
+            if (rc && queue.empty()) {
+                break;
+            }
+        }
+        if (queue.empty() || stop) {
+            break;
+        }
+        QoreV8AsyncCall* call = queue.front();
+        queue.pop_front();
+        {
+            AutoUnlocker aul(m);
+            call->run();
+            // passes ownership of the call to the program
+            call->pgm->postAsyncCall(call);
+        }
+    }
+    --threads;
+    cond.broadcast();
+}
@@ -0,0 +1,65 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+
+#ifndef _QORE_QOREV8ASYNCCALL
+
+#define _QORE_QOREV8ASYNCCALL
+
+#include "v8-module.h"
+
+#include <deque>
+
+class QoreV8Program;
+
+//! A call to %Qore code made asynchronously from JavaScript
+/** The call is run in a worker thread, and the result is passed back to the program's event loop to settle the
+    Promise returned to JavaScript
+*/
+struct QoreV8AsyncCall {
+    //! the program that made the call; a weak reference is held
+    QoreV8Program* pgm;
+    //! identifies the Promise resolver in the program
+    int64 id;
+    //! the code to call
+    ResolvedCallReferenceNode* code;
+    //! the arguments, if any
+    QoreListNode* args;
+    //! the return value
+    QoreValue rv;
+    //! any exception raised by the call
+    ExceptionSink xsink;
+
+    //! takes ownership of the references to \a code and \a args
+    DLLLOCAL QoreV8AsyncCall(QoreV8Program* pgm, int64 id, ResolvedCallReferenceNode* code, QoreListNode* args);
+
+    DLLLOCAL ~QoreV8AsyncCall();
+
+    //! Releases the %Qore values held by the call
+    DLLLOCAL void release(ExceptionSink* xsink);
+
+    //! Runs the call in the current thread
+    DLLLOCAL void run();
+};
+
+//! Module-wide pool of worker threads for asynchronous %Qore calls
+/** Threads are started on demand up to a maximum and exit after being idle for some time
+*/
+class QoreV8AsyncWorkerPool {
+public:
+    //! Queues the call; returns 0 for OK, -1 if an error occurred
+    DLLLOCAL static int submit(ExceptionSink* xsink, QoreV8AsyncCall* call);
+
+    //! Stops all worker threads; queued calls are discarded
+    DLLLOCAL static void shutdown();
+
+private:
+    static QoreThreadLock m;
+    static QoreCondition cond;
+    static std::deque<QoreV8AsyncCall*> queue;
+    static unsigned threads;
+    static unsigned idle;
+    static bool stop;
+
+    DLLLOCAL static void worker_thread(ExceptionSink* xsink, void* arg);
+};
+
+#endif
@@ -0,0 +1,273 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+    QoreV8CodeCache.cpp
+
+    Qore Programming Language
+
+    Copyright (C) 2024 Qore Technologies, s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+    DEALINGS IN THE SOFTWARE.
+
+    Note that the Qore library is released under a choice of three open-source
+    licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+    information.
+*/
+
+
+#include "QoreV8CodeCache.h"
+
+#include <cstdio>
+#include <cerrno>
+#include <sys/stat.h>
+#include <unistd.h>
+
+QoreThreadLock QoreV8CodeCache::m;
+QoreV8CodeCache::cmap_t QoreV8CodeCache::cmap;
+QoreV8CodeCache::lru_t QoreV8CodeCache::lru;
+std::string QoreV8CodeCache::dir;
+size_t QoreV8CodeCache::bytes = 0;
+
+std::atomic<int64> QoreV8CodeCache::hits(0),
+    QoreV8CodeCache::misses(0),
+    QoreV8CodeCache::rejected(0),
+    QoreV8CodeCache::produced(0),
+    QoreV8CodeCache::evictions(0),
+    QoreV8CodeCache::disk_reads(0),
+    QoreV8CodeCache::disk_writes(0),
+    QoreV8CodeCache::disk_errors(0);
+
+std::string QoreV8CodeCache::getKey(const QoreString& source) {
+    // 64-bit FNV-1a hash; stable across processes, so it can be used for file names
+    uint64_t h = 0xcbf29ce484222325ULL;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(source.c_str());
+    for (size_t i = 0, e = source.size(); i < e; ++i) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+
+    QoreStringMaker key("%016llx-%zx-%s-%08x", (unsigned long long)h, source.size(), v8::V8::GetVersion(),
+        v8::ScriptCompiler::CachedDataVersionTag());
+    return key.c_str();
+}
+
+QoreV8CodeCache::data_t QoreV8CodeCache::get(const std::string& key) {
+    std::string path;
+    {
+        AutoLocker al(m);
+        cmap_t::iterator i = cmap.find(key);
+        if (i != cmap.end()) {
+            lru.splice(lru.begin(), lru, i->second.pos);
+            return i->second.data;
+        }
+        if (dir.empty()) {
+            ++misses;
+            return data_t();
+        }
+        path = getPath(key);
+    }
+
+    data_t rv = readFile(path);
+    if (!rv) {
+        ++misses;
+        return rv;
+    }
+
+    AutoLocker al(m);
+    cmap_t::iterator i = cmap.lower_bound(key);
+    if (i != cmap.end() && i->first == key) {
+        // another thread has already loaded or produced the data
+        lru.splice(lru.begin(), lru, i->second.pos);
+        return i->second.data;
+    }
+    insert(i, key, rv);
+    return rv;
+}
+
+void QoreV8CodeCache::put(const std::string& key, const uint8_t* data, int len) {
+    ++produced;
+    data_t d = std::make_shared<const std::string>(reinterpret_cast<const char*>(data), len);
+
+    std::string path;
+    {
+        AutoLocker al(m);
+        cmap_t::iterator i = cmap.lower_bound(key);
+        if (i != cmap.end() && i->first == key) {
+            bytes -= i->second.data->size();
+            i->second.data = d;
+            bytes += len;
+            lru.splice(lru.begin(), lru, i->second.pos);
+            trim();
+        } else {
+            insert(i, key, d);
+        }
+        if (dir.empty()) {
+            return;
+        }
+        path = getPath(key);
+    }
+
+    writeFile(path, d);
+}
+
+void QoreV8CodeCache::reject(const std::string& key) {
+    ++rejected;
+    std::string path;
+    {
+        AutoLocker al(m);
+        cmap_t::iterator i = cmap.find(key);
+        if (i != cmap.end()) {
+            erase(i);
+        }
+        if (dir.empty()) {
+            return;
+        }
+        path = getPath(key);
+    }
+    // the file will be replaced when the new cache data has been produced, but remove it here in case the data
+    // cannot be produced
+    unlink(path.c_str());
+}
+
+int QoreV8CodeCache::setDir(const char* new_dir, ExceptionSink* xsink) {
+    if (new_dir && *new_dir) {
+        struct stat sbuf;
+        if (stat(new_dir, &sbuf)) {
+            xsink->raiseErrnoException("JAVASCRIPT-CODE-CACHE-ERROR", errno, "cannot use code cache directory "
+                "'%s'", new_dir);
+            return -1;
+        }
+        if (!S_ISDIR(sbuf.st_mode)) {
+            xsink->raiseException("JAVASCRIPT-CODE-CACHE-ERROR", "cannot use code cache directory '%s': not a "
+                "directory", new_dir);
+            return -1;
+        }
+    }
+
+    AutoLocker al(m);
+    if (new_dir) {
+        dir = new_dir;
+        // remove any trailing directory separators
+        while (dir.size() > 1 && dir.back() == '/') {
+            dir.pop_back();
+        }
+    } else {
+        dir.clear();
+    }
+    return 0;
+}
+
+QoreStringNode* QoreV8CodeCache::getDir() {
+    AutoLocker al(m);
+    return dir.empty() ? nullptr : new QoreStringNode(dir.c_str());
+}
+
+QoreHashNode* QoreV8CodeCache::getStats() {
+    ReferenceHolder<QoreHashNode> rv(new QoreHashNode(autoTypeInfo), nullptr);
+    {
+        AutoLocker al(m);
+        rv->setKeyValue("entries", (int64)cmap.size(), nullptr);
+        rv->setKeyValue("bytes", (int64)bytes, nullptr);
+        rv->setKeyValue("dir", dir.empty() ? QoreValue() : QoreValue(new QoreStringNode(dir.c_str())), nullptr);
+    }
+    rv->setKeyValue("hits", hits.load(), nullptr);
+    rv->setKeyValue("misses", misses.load(), nullptr);
+    rv->setKeyValue("rejected", rejected.load(), nullptr);
+    rv->setKeyValue("produced", produced.load(), nullptr);
+    rv->setKeyValue("evictions", evictions.load(), nullptr);
+    rv->setKeyValue("disk_reads", disk_reads.load(), nullptr);
+    rv->setKeyValue("disk_writes", disk_writes.load(), nullptr);
+    rv->setKeyValue("disk_errors", disk_errors.load(), nullptr);
+    return rv.release();
+}
+
+void QoreV8CodeCache::clear() {
+    AutoLocker al(m);
+    cmap.clear();
+    lru.clear();
+    bytes = 0;
+}
+
+void QoreV8CodeCache::insert(cmap_t::iterator hint, const std::string& key, const data_t& data) {
+    lru.push_front(key);
+    cmap.insert(hint, cmap_t::value_type(key, entry_t{data, lru.begin()}));
+    bytes += data->size();
+    trim();
+}
+
+void QoreV8CodeCache::erase(cmap_t::iterator i) {
+    bytes -= i->second.data->size();
+    lru.erase(i->second.pos);
+    cmap.erase(i);
+}
+
+void QoreV8CodeCache::trim() {
+    // the most recently used entry is always kept, even if it exceeds the limit by itself
+    while (bytes > max_bytes && cmap.size() > 1) {
+        erase(cmap.find(lru.back()));
+        ++evictions;
+    }
+}
+
+std::string QoreV8CodeCache::getPath(const std::string& key) {
+    return dir + "/" + key + ".v8cache";
+}
+
+QoreV8CodeCache::data_t QoreV8CodeCache::readFile(const std::string& path) {
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) {
+        if (errno != ENOENT) {
+            ++disk_errors;
+        }
+        return data_t();
+    }
+    std::shared_ptr<std::string> rv = std::make_shared<std::string>();
+    char buf[65536];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof buf, fp))) {
+        rv->append(buf, len);
+    }
+    bool err = ferror(fp);
+    fclose(fp);
+    if (err || rv->empty()) {
+        ++disk_errors;
+        return data_t();
+    }
+    ++disk_reads;
+    return rv;
+}
+
+void QoreV8CodeCache::writeFile(const std::string& path, const data_t& data) {
+    // write to a temporary file and rename it, so that concurrent readers never see partial data
+    QoreStringMaker tmp("%s.%d.%d.tmp", path.c_str(), (int)getpid(), q_gettid());
+    FILE* fp = fopen(tmp.c_str(), "wb");
+    if (!fp) {
+        ++disk_errors;
+        return;
+    }
+    bool err = fwrite(data->data(), 1, data->size(), fp) != data->size();
+    if (fclose(fp)) {
+        err = true;
+    }
+    if (err || rename(tmp.c_str(), path.c_str())) {
+        unlink(tmp.c_str());
+        ++disk_errors;
+        return;
+    }
+    ++disk_writes;
+}
@@ -0,0 +1,130 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+    QoreV8CodeCache.h
+
+    Qore Programming Language
+
+    Copyright (C) 2024 Qore Technologies, s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+    DEALINGS IN THE SOFTWARE.
+
+    Note that the Qore library is released under a choice of three open-source
+    licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+    information.
+*/
+
+
+#ifndef _QORE_QOREV8CODECACHE
+
+#define _QORE_QOREV8CODECACHE
+
+#include "v8-module.h"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <atomic>
+
+//! Process-wide cache of V8 code cache data for program sources
+/** Entries are keyed by a hash of the source, the V8 version and the V8 cached data version tag (which reflects the
+    V8 flags in effect); if a cache directory is set, entries are also persisted to and loaded from disk, so that
+    compile work can be skipped across restarts.
+
+    The in-memory cache is limited to max_bytes; when the limit is exceeded, the least recently used entries are
+    removed from memory (but not from disk).
+*/
+class QoreV8CodeCache {
+public:
+    typedef std::shared_ptr<const std::string> data_t;
+
+    //! Returns the cache key for the given source
+    DLLLOCAL static std::string getKey(const QoreString& source);
+
+    //! Returns cached data for the given key, if any
+    DLLLOCAL static data_t get(const std::string& key);
+
+    //! Stores cache data for the given key in memory and on disk if a cache directory is set
+    DLLLOCAL static void put(const std::string& key, const uint8_t* data, int len);
+
+    //! Called when V8 rejects cached data; removes the entry
+    DLLLOCAL static void reject(const std::string& key);
+
+    //! Called when cached data has been accepted by V8
+    DLLLOCAL static void hit() {
+        ++hits;
+    }
+
+    //! Sets the cache directory; nullptr = no persistent cache
+    DLLLOCAL static int setDir(const char* dir, ExceptionSink* xsink);
+
+    //! Returns the cache directory or nullptr if not set
+    DLLLOCAL static QoreStringNode* getDir();
+
+    //! Returns cache statistics
+    DLLLOCAL static QoreHashNode* getStats();
+
+    //! Clears the in-memory cache
+    DLLLOCAL static void clear();
+
+    //! The maximum size of the in-memory cache in bytes
+    static constexpr size_t max_bytes = 64 * 1024 * 1024;
+
+private:
+    // keys in order of use; the most recently used entry is at the front
+    typedef std::list<std::string> lru_t;
+
+    struct entry_t {
+        data_t data;
+        // the position of the key in the LRU list
+        lru_t::iterator pos;
+    };
+
+    typedef std::map<std::string, entry_t> cmap_t;
+
+    static QoreThreadLock m;
+    static cmap_t cmap;
+    static lru_t lru;
+    static std::string dir;
+    static size_t bytes;
+
+    static std::atomic<int64> hits,
+        misses,
+        rejected,
+        produced,
+        evictions,
+        disk_reads,
+        disk_writes,
+        disk_errors;
+
+    //! Adds a new entry as the most recently used entry; must be called with the lock held
+    DLLLOCAL static void insert(cmap_t::iterator hint, const std::string& key, const data_t& data);
+
+    //! Removes the given entry; must be called with the lock held
+    DLLLOCAL static void erase(cmap_t::iterator i);
+
+    //! Removes the least recently used entries until the cache is within max_bytes; must be called with the lock held
+    DLLLOCAL static void trim();
+
+    DLLLOCAL static std::string getPath(const std::string& key);
+    DLLLOCAL static data_t readFile(const std::string& path);
+    DLLLOCAL static void writeFile(const std::string& path, const data_t& data);
+};
+
+#endif
@@ -0,0 +1,220 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+
+#include "QoreV8EventLoop.h"
+#include "QoreV8Program.h"
+
+#include <optional>
+#include <poll.h>
+#include <errno.h>
+
+int QoreV8EventLoop::start(ExceptionSink* xsink) {
+    AutoLocker al(m);
+    if (running) {
+        if (!stop_flag) {
+            return 0;
+        }
+        // wait for a stopping thread to exit before starting a new one
+        if (tid == q_gettid()) {
+            xsink->raiseException("JAVASCRIPT-EVENT-LOOP-ERROR", "cannot restart the event loop thread from the "
+                "event loop thread while it is stopping");
+            return -1;
+        }
+        while (running) {
+            cond.wait(&m);
+        }
+    }
+    stop_flag = false;
+    async_ready = false;
+    running = true;
+    pgm->weakRef();
+    if (q_start_thread(xsink, loop_thread, this) < 0) {
+        running = false;
+        pgm->weakDeref();
+        return -1;
+    }
+    return 0;
+}
+
+void QoreV8EventLoop::stop() {
+    // release the isolate lock if held by the current thread, as the loop thread needs it to exit
+    std::optional<v8::Unlocker> unlocker;
+    v8::Isolate* isolate = pgm->getIsolate();
+    if (v8::Locker::IsLocked(isolate)) {
+        unlocker.emplace(isolate);
+    }
+
+    AutoLocker al(m);
+    if (!running) {
+        return;
+    }
+    stop_flag = true;
+    if (async_ready) {
+        uv_async_send(&async);
+    }
+    if (tid != q_gettid()) {
+        while (running) {
+            cond.wait(&m);
+        }
+    }
+}
+
+QoreValue QoreV8EventLoop::run(ExceptionSink* xsink, const ResolvedCallReferenceNode* code,
+        const QoreListNode* args) {
+    if (inLoopThread()) {
+        return code->execValue(args, xsink);
+    }
+
+    QoreV8EventLoopTask task(code, args);
+    {
+        // release the isolate lock if held by the current thread, as the loop thread needs it to run the call
+        std::optional<v8::Unlocker> unlocker;
+        v8::Isolate* isolate = pgm->getIsolate();
+        if (v8::Locker::IsLocked(isolate)) {
+            unlocker.emplace(isolate);
+        }
+
+        AutoLocker al(m);
+        if (!running || stop_flag) {
+            xsink->raiseException("JAVASCRIPT-EVENT-LOOP-ERROR", "the event loop thread is not running");
+            return QoreValue();
+        }
+        queue.push_back(&task);
+        if (async_ready) {
+            uv_async_send(&async);
+        }
+        while (!task.done) {
+            cond.wait(&m);
+        }
+    }
+    if (task.xsink) {
+        xsink->assimilate(task.xsink);
+    }
+    return task.rv;
+}
+
+int QoreV8EventLoop::waitPass(int64 last_pass, int timeout_ms) {
+    AutoLocker al(m);
+    while (pass == last_pass) {
+        if (!running || stop_flag) {
+            return -1;
+        }
+        if (cond.wait(&m, timeout_ms)) {
+            break;
+        }
+    }
+    return 0;
+}
+
+void QoreV8EventLoop::pollBackend(uv_loop_t* loop, int timeout_ms) {
+    struct pollfd pfd;
+    pfd.fd = uv_backend_fd(loop);
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    int rc;
+    do {
+        rc = poll(&pfd, 1, timeout_ms);
+    } while (rc == -1 && errno == EINTR);
+}
+
+void QoreV8EventLoop::runTasks() {
+    while (true) {
+        QoreV8EventLoopTask* task;
+        {
+            AutoLocker al(m);
+            if (queue.empty()) {
+                return;
+            }
+            task = queue.front();
+            queue.pop_front();
+        }
+        ValueHolder rv(task->code->execValue(task->args, &task->xsink), &task->xsink);
+        AutoLocker al(m);
+        task->rv = task->xsink ? QoreValue() : rv.release();
+        task->done = true;
+        cond.broadcast();
+    }
+}
+
+void QoreV8EventLoop::async_callback(uv_async_t* handle) {
+    reinterpret_cast<QoreV8EventLoop*>(handle->data)->runTasks();
+}
+
+void QoreV8EventLoop::loop_thread(ExceptionSink* xsink, void* arg) {
+    QoreV8EventLoop* el = reinterpret_cast<QoreV8EventLoop*>(arg);
+    QoreV8Program* pgm = el->pgm;
+    el->loop(xsink);
+    pgm->weakDeref();
+}
+
+void QoreV8EventLoop::loop(ExceptionSink* xsink) {
+    v8::Isolate* isolate = pgm->getIsolate();
+    uv_loop_t* uv_loop = pgm->getEventLoop();
+
+    {
+        v8::Locker locker(isolate);
+        v8::Isolate::Scope isolate_scope(isolate);
+        v8::HandleScope handle_scope(isolate);
+        v8::Local<v8::Context> context = pgm->getContext();
+        v8::Context::Scope context_scope(context);
+
+        // the async handle is kept referenced, so the loop is always alive while the thread is running, and every
+        // pass polls the backend, which registers the async handle's fd with it; otherwise a wakeup sent while the
+        // loop has nothing else to do would not interrupt the poll below
+        uv_async_init(uv_loop, &async, async_callback);
+        async.data = this;
+        {
+            AutoLocker al(m);
+            tid = q_gettid();
+            async_ready = true;
+        }
+
+        while (true) {
+            {
+                AutoLocker al(m);
+                if (stop_flag) {
+                    break;
+                }
+            }
+
+            {
+                v8::HandleScope pass_scope(isolate);
+                runTasks();
+                uv_run(uv_loop, UV_RUN_NOWAIT);
+                isolate->PerformMicrotaskCheckpoint();
+                {
+                    AutoLocker al(m);
+                    ++pass;
+                    cond.broadcast();
+                }
+
+                // release the isolate lock while blocked; queued calls and stop requests wake up the backend
+                // through the async handle
+                int timeout_ms = uv_backend_timeout(uv_loop);
+                if (timeout_ms) {
+                    v8::Unlocker unlocker(isolate);
+                    pollBackend(uv_loop, timeout_ms);
+                }
+            }
+        }
+
+        {
+            AutoLocker al(m);
+            async_ready = false;
+        }
+        // process the close of the async handle
+        uv_close(reinterpret_cast<uv_handle_t*>(&async), nullptr);
+        uv_run(uv_loop, UV_RUN_NOWAIT);
+    }
+
+    AutoLocker al(m);
+    // fail any calls posted after the loop stopped
+    for (QoreV8EventLoopTask* task : queue) {
+        task->xsink.raiseException("JAVASCRIPT-EVENT-LOOP-ERROR", "the event loop thread was stopped before the "
+            "call could be run");
+        task->done = true;
+    }
+    queue.clear();
+    tid = -1;
+    running = false;
+    cond.broadcast();
+}
@@ -0,0 +1,112 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+
+#ifndef _QORE_QOREV8EVENTLOOP
+
+#define _QORE_QOREV8EVENTLOOP
+
+#include "v8-module.h"
+
+#include <uv.h>
+
+#include <deque>
+
+class QoreV8Program;
+
+//! A call posted to the event loop thread
+struct QoreV8EventLoopTask {
+    const ResolvedCallReferenceNode* code;
+    const QoreListNode* args;
+    QoreValue rv;
+    ExceptionSink xsink;
+    bool done = false;
+
+    DLLLOCAL QoreV8EventLoopTask(const ResolvedCallReferenceNode* code, const QoreListNode* args)
+            : code(code), args(args) {
+    }
+};
+
+//! A thread that owns and continuously runs the libuv event loop of a program
+/** Timers and I/O make progress without any %Qore thread waiting on the program.  Calls from other threads are
+    posted to a queue and signalled with a \c uv_async_t handle; the caller waits on a condition variable for the
+    result.  The isolate lock is only held by the loop thread while dispatching callbacks, microtasks and queued
+    calls, and is released while blocked waiting for I/O.
+*/
+class QoreV8EventLoop {
+public:
+    DLLLOCAL QoreV8EventLoop(QoreV8Program* pgm) : pgm(pgm) {
+    }
+
+    DLLLOCAL ~QoreV8EventLoop() {
+        assert(!running);
+    }
+
+    //! Starts the loop thread; returns 0 if the thread is running, -1 if an error occurred
+    DLLLOCAL int start(ExceptionSink* xsink);
+
+    //! Stops the loop thread; waits for it to exit unless called in the loop thread
+    DLLLOCAL void stop();
+
+    //! Returns true if the loop thread is running
+    DLLLOCAL bool isRunning() const {
+        AutoLocker al(m);
+        return running && !stop_flag;
+    }
+
+    //! Wakes up the loop thread so that changes made to the loop by other threads are processed
+    DLLLOCAL void wakeup() {
+        AutoLocker al(m);
+        if (async_ready && tid != q_gettid()) {
+            uv_async_send(&async);
+        }
+    }
+
+    //! Returns true if called in the loop thread
+    DLLLOCAL bool inLoopThread() const {
+        return tid == q_gettid();
+    }
+
+    //! Calls the given code in the loop thread and waits for the result
+    DLLLOCAL QoreValue run(ExceptionSink* xsink, const ResolvedCallReferenceNode* code, const QoreListNode* args);
+
+    //! Returns the number of completed loop passes
+    DLLLOCAL int64 getPass() const {
+        AutoLocker al(m);
+        return pass;
+    }
+
+    //! Waits up to \a timeout_ms for a loop pass after \a last_pass to complete
+    /** @return 0 if a pass completed or the timeout expired, -1 if the loop thread is not running
+    */
+    DLLLOCAL int waitPass(int64 last_pass, int timeout_ms);
+
+    //! Waits up to \a timeout_ms for I/O on the loop's backend without running any callbacks
+    /** a negative timeout means wait indefinitely
+    */
+    DLLLOCAL static void pollBackend(uv_loop_t* loop, int timeout_ms);
+
+private:
+    QoreV8Program* pgm;
+
+    mutable QoreThreadLock m;
+    //! signalled when a loop pass or task completes, and when the thread starts or stops
+    QoreCondition cond;
+    std::deque<QoreV8EventLoopTask*> queue;
+    uv_async_t async;
+    int tid = -1;
+    int64 pass = 0;
+    bool running = false;
+    bool stop_flag = false;
+    bool async_ready = false;
+
+    //! Runs all queued tasks; must be called in the loop thread with the isolate lock held
+    DLLLOCAL void runTasks();
+
+    //! Runs the loop until stopped
+    DLLLOCAL void loop(ExceptionSink* xsink);
+
+    DLLLOCAL static void loop_thread(ExceptionSink* xsink, void* arg);
+
+    DLLLOCAL static void async_callback(uv_async_t* handle);
+};
+
+#endif
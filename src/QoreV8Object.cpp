@@ -33,7 +33,9 @@
 #include "QoreV8Program.h"
 #include "QoreV8CallReference.h"
 
+#include <algorithm>
 #include <climits>
+#include <vector>
 
 QoreV8Object::QoreV8Object(QoreV8Program* pgm, v8::Local<v8::Object> obj) : pgm(pgm) {
     pgm->weakRef();
@@ -50,15 +52,29 @@ QoreObject* QoreV8Object::getReferencedProgram() {
 }
 
 AbstractQoreNode* QoreV8Object::toData(QoreV8ProgramHelper& v8h) const {
+    v8::Local<v8::Object> obj = get();
+    if (obj->IsCallable()) {
+        return new QoreV8CallReference(this, v8::Null(v8h.getIsolate()));
+    }
     // the set is to ensure that we only report each object once
     v8::Local<v8::Set> objset = v8::Set::New(v8h.getIsolate());
-    return toData(v8h, v8::Null(v8h.getIsolate()), **objset);
+    return toData(v8h, obj, v8::Null(v8h.getIsolate()), **objset);
 }
 
-AbstractQoreNode* QoreV8Object::toData(QoreV8ProgramHelper& v8h, v8::Local<v8::Value> parent,
-        v8::Set& objset) const {
+AbstractQoreNode* QoreV8Object::toData(QoreV8ProgramHelper& v8h, v8::Local<v8::Object> obj,
+        v8::Local<v8::Value> parent, v8::Set& objset) {
     ExceptionSink* xsink = v8h.getExceptionSink();
-    v8::Local<v8::Object> obj = get();
+    // container proxies are returned as the original hash or list
+    {
+        QoreValue c = v8h.getProgram()->getProxiedValue(obj);
+        if (c) {
+            return c.takeNode();
+        }
+    }
+    // buffers and typed arrays are converted in bulk, and dates are converted directly
+    if (obj->IsArrayBufferView() || obj->IsArrayBuffer() || obj->IsSharedArrayBuffer() || obj->IsDate()) {
+        return v8h.getProgram()->getQoreValue(xsink, obj).takeNode();
+    }
     {
         v8::Maybe<bool> b = objset.Has(v8h.getContext(), obj);
         if (b.IsNothing()) {
@@ -75,11 +91,41 @@ AbstractQoreNode* QoreV8Object::toData(QoreV8ProgramHelper& v8h, v8::Local<v8::V
         }
     }
     if (obj->IsCallable()) {
-        return new QoreV8CallReference(this, parent);
+        // a QoreV8Object is only created for callable objects, which are returned as call references
+        ReferenceHolder<QoreV8Object> callable(new QoreV8Object(v8h.getProgram(), obj), xsink);
+        return new QoreV8CallReference(*callable, parent);
     }
 
-    v8::Isolate* isolate = v8h.getIsolate();
-    v8::EscapableHandleScope handle_scope(isolate);
+    // release the temporary handles for each nested object
+    v8::HandleScope handle_scope(v8h.getIsolate());
+
+    if (obj->IsArray()) {
+        return toList(v8h, obj.As<v8::Array>(), parent, objset);
+    }
+
+    // Maps and Sets are converted from their entries in a single pass
+    if (obj->IsMap()) {
+        ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
+        int rc = QoreV8Program::getHash(xsink, v8h.getIsolate(), v8h.getContext(), obj.As<v8::Map>(), *h,
+            [&v8h, obj, &objset] (v8::Local<v8::Value> v) {
+                return toData(v8h, v, obj, objset);
+            });
+        if (rc < 0) {
+            if (!*xsink) {
+                v8h.checkException();
+            }
+            return nullptr;
+        }
+        if (!rc) {
+            return h.release();
+        }
+        // Maps with other keys are returned as JavaScriptObject objects
+        return v8h.getProgram()->getQoreValue(xsink, obj).takeNode();
+    }
+
+    if (obj->IsSet()) {
+        return toList(v8h, obj.As<v8::Set>()->AsArray(), parent, objset);
+    }
 
     v8::MaybeLocal<v8::Array> maybe_props = obj->GetPropertyNames(v8h.getContext());
     if (maybe_props.IsEmpty()) {
@@ -89,21 +135,15 @@ AbstractQoreNode* QoreV8Object::toData(QoreV8ProgramHelper& v8h, v8::Local<v8::V
         return new QoreHashNode(autoTypeInfo);
     }
 
-    v8::Local<v8::Array> props = maybe_props.ToLocalChecked();
-    // check the first prop; if it's an integer, then it's an array
-    uint32_t len = props->Length();
-    if (!len) {
-        if (obj->IsArray()) {
-            return new QoreListNode(autoTypeInfo);
-        } else {
-            return new QoreHashNode(autoTypeInfo);
-        }
-    }
+    return toHash(v8h, obj, objset, maybe_props.ToLocalChecked());
+}
 
-    if (obj->IsArray()) {
-        return toList(v8h, parent, objset, handle_scope.Escape(props), len);
+QoreValue QoreV8Object::toData(QoreV8ProgramHelper& v8h, v8::Local<v8::Value> val, v8::Local<v8::Value> parent,
+        v8::Set& objset) {
+    if (val->IsObject()) {
+        return toData(v8h, val.As<v8::Object>(), parent, objset);
     }
-    return toHash(v8h, parent, objset, handle_scope.Escape(props), len);
+    return v8h.getProgram()->getQoreValue(v8h.getExceptionSink(), val);
 }
 
 QoreStringNode* QoreV8Object::toString(QoreV8ProgramHelper& v8h) const {
@@ -116,8 +156,7 @@ QoreStringNode* QoreV8Object::toString(QoreV8ProgramHelper& v8h) const {
         }
         return nullptr;
     }
-    v8::String::Utf8Value str(v8h.getIsolate(), s.ToLocalChecked());
-    return new QoreStringNode(*str, QCS_UTF8);
+    return QoreV8Program::getQoreString(v8h.getIsolate(), s.ToLocalChecked());
 }
 
 QoreListNode* QoreV8Object::getPropertyList(QoreV8ProgramHelper& v8h) {
@@ -185,28 +224,85 @@ QoreValue QoreV8Object::methodGate(ExceptionSink* xsink, QoreObject* self, const
         return QoreValue();
     }
 
-    v8::Local<v8::Value> attr = getV8KeyValue(v8h, m->c_str());
-    if (*xsink) {
+    v8::Local<v8::Function> meth = getMethod(v8h, m->c_str());
+    if (meth.IsEmpty()) {
         return QoreValue();
     }
+    return callFunction(v8h, meth, get(), 1, args);
+}
 
-    if (!attr->IsObject()) {
-        v8::Local<v8::String> str = attr->TypeOf(v8h.getIsolate());
-        // Convert the result to an UTF8 string
-        v8::String::Utf8Value utf8(v8h.getIsolate(), str);
-        xsink->raiseException("JAVASCRIPT-METHODCALL-ERROR", "Object key '%s' is v8 type '%s'; must be a callable "
-            "object to make a method call", m->c_str(), *utf8);
-        return QoreValue();
+v8::Local<v8::Function> QoreV8Object::getMethod(QoreV8ProgramHelper& v8h, const char* name) {
+    v8::Isolate* isolate = v8h.getIsolate();
+
+    // the lookup is always made, so methods reassigned in JavaScript are always found
+    v8::Local<v8::String> key = getKey(v8h, name, strlen(name));
+    if (key.IsEmpty()) {
+        return v8::Local<v8::Function>();
     }
 
-    v8::MaybeLocal<v8::Object> maybe_attrobj = attr->ToObject(v8h.getContext());
-    if (maybe_attrobj.IsEmpty()) {
+    v8::MaybeLocal<v8::Value> m_val = get()->Get(v8h.getContext(), key);
+    if (m_val.IsEmpty()) {
         v8h.checkException();
-        return QoreValue();
+        return v8::Local<v8::Function>();
+    }
+    v8::Local<v8::Value> attr = m_val.ToLocalChecked();
+    if (!attr->IsFunction()) {
+        v8::Local<v8::String> str = attr->TypeOf(isolate);
+        // Convert the result to an UTF8 string
+        v8::String::Utf8Value utf8(isolate, str);
+        v8h.getExceptionSink()->raiseException("JAVASCRIPT-METHODCALL-ERROR", "Object key '%s' is v8 type '%s'; "
+            "must be a callable object to make a method call", name, *utf8);
+        return v8::Local<v8::Function>();
     }
+    return attr.As<v8::Function>();
+}
 
-    ReferenceHolder<QoreV8Object> meth(new QoreV8Object(getProgram(), maybe_attrobj.ToLocalChecked()), xsink);
-    return meth->callAsFunction(v8h, self, 1, args);
+v8::Local<v8::String> QoreV8Object::getKey(QoreV8ProgramHelper& v8h, const char* name, size_t len) {
+    v8::MaybeLocal<v8::String> m_key = pgm->getKeyString(name, len);
+    if (m_key.IsEmpty()) {
+        if (!v8h.checkException()) {
+            v8h.getExceptionSink()->raiseException("JAVASCRIPT-ERROR", "Unknown error processing property string");
+        }
+        return v8::Local<v8::String>();
+    }
+    return m_key.ToLocalChecked();
+}
+
+v8::Local<v8::Object> QoreV8Object::getPathParent(QoreV8ProgramHelper& v8h, const char* path, bool paths,
+        v8::Local<v8::String>& key) {
+    v8::Local<v8::Object> parent = get();
+    v8::Local<v8::Context> context = v8h.getContext();
+    while (true) {
+        const char* p = paths ? strchr(path, '.') : nullptr;
+        key = getKey(v8h, path, p ? (size_t)(p - path) : strlen(path));
+        if (key.IsEmpty()) {
+            return v8::Local<v8::Object>();
+        }
+        if (!p) {
+            return parent;
+        }
+        // intermediate values are not converted to Qore
+        v8::MaybeLocal<v8::Value> m_val = parent->Get(context, key);
+        if (m_val.IsEmpty()) {
+            v8h.checkException();
+            return v8::Local<v8::Object>();
+        }
+        v8::Local<v8::Value> val = m_val.ToLocalChecked();
+        if (!val->IsObject()) {
+            return v8::Local<v8::Object>();
+        }
+        parent = val.As<v8::Object>();
+        path = p + 1;
+    }
+}
+
+ResolvedCallReferenceNode* QoreV8Object::getBoundMethod(QoreV8ProgramHelper& v8h, const char* name) {
+    v8::Local<v8::Function> meth = getMethod(v8h, name);
+    if (meth.IsEmpty()) {
+        return nullptr;
+    }
+    ReferenceHolder<QoreV8Object> callable(new QoreV8Object(pgm, meth), v8h.getExceptionSink());
+    return new QoreV8CallReference(*callable, get());
 }
 
 QoreValue QoreV8Object::memberGate(ExceptionSink* xsink, const QoreStringNode* m) {
@@ -223,15 +319,28 @@ QoreValue QoreV8Object::memberGate(ExceptionSink* xsink, const QoreStringNode* m
     return v8h.getProgram()->getQoreValue(xsink, attr);
 }
 
-QoreHashNode* QoreV8Object::toHash(QoreV8ProgramHelper& v8h, v8::Local<v8::Value> parent, v8::Set& objset,
-        v8::Local<v8::Array> props, uint32_t len) const {
+// sets the string for the given property name without creating a temporary Qore value
+static void get_key_string(v8::Isolate* isolate, v8::Local<v8::Value> k, QoreString& str) {
+    str.clear();
+    if (k->IsUint32()) {
+        str.sprintf("%u", k.As<v8::Uint32>()->Value());
+        return;
+    }
+    v8::String::Utf8Value utf8(isolate, k);
+    str.concat(*utf8, utf8.length());
+}
+
+QoreHashNode* QoreV8Object::toHash(QoreV8ProgramHelper& v8h, v8::Local<v8::Object> obj, v8::Set& objset,
+        v8::Local<v8::Array> props) {
     ExceptionSink* xsink = v8h.getExceptionSink();
-    v8::Local<v8::Object> obj = get();
+    v8::Isolate* isolate = v8h.getIsolate();
+    v8::Local<v8::Context> context = v8h.getContext();
 
     ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
+    QoreString kstr(QCS_UTF8);
 
-    for (uint32_t i = 0, e = len; i < e; ++i) {
-        v8::MaybeLocal<v8::Value> key = props->Get(v8h.getContext(), i);
+    for (uint32_t i = 0, e = props->Length(); i < e; ++i) {
+        v8::MaybeLocal<v8::Value> key = props->Get(context, i);
         if (key.IsEmpty()) {
             if (v8h.checkException()) {
                 return nullptr;
@@ -239,116 +348,41 @@ QoreHashNode* QoreV8Object::toHash(QoreV8ProgramHelper& v8h, v8::Local<v8::Value
             continue;
         }
         v8::Local<v8::Value> k = key.ToLocalChecked();
-        ValueHolder qk(v8h.getProgram()->getQoreValue(xsink, k), xsink);
-        if (*xsink) {
-            if (v8h.checkException()) {
-                return nullptr;
-            }
-            continue;
-        }
-        QoreStringValueHelper kstr(*qk);
-        v8::MaybeLocal<v8::Value> value = obj->Get(v8h.getContext(), k);
+        get_key_string(isolate, k, kstr);
+
+        v8::MaybeLocal<v8::Value> value = obj->Get(context, k);
         if (value.IsEmpty()) {
             if (v8h.checkException()) {
                 return nullptr;
             }
-            h->setKeyValue(kstr->c_str(), QoreValue(), xsink);
+            h->setKeyValue(kstr.c_str(), QoreValue(), xsink);
             assert(!*xsink);
             continue;
         }
-        v8::Local<v8::Value> v = value.ToLocalChecked();
-        if (v->IsObject()) {
-            v8::MaybeLocal<v8::Object> o = v->ToObject(v8h.getContext());
-            if (o.IsEmpty()) {
-                if (v8h.checkException()) {
-                    return nullptr;
-                }
-                continue;
-            }
-            v8::Local<v8::Object> obj = o.ToLocalChecked();
-            ReferenceHolder<QoreV8Object> tmp(new QoreV8Object(v8h.getProgram(), obj), xsink);
-            ReferenceHolder<AbstractQoreNode> h0(tmp->toData(v8h, obj, objset), xsink);
-            if (*xsink) {
-                return nullptr;
-            }
-            h->setKeyValue(kstr->c_str(), h0.release(), xsink);
-            continue;
-        }
-        ValueHolder qv(v8h.getProgram()->getQoreValue(xsink, v), xsink);
+        // methods are called with the containing object as "this"
+        ValueHolder qv(toData(v8h, value.ToLocalChecked(), obj, objset), xsink);
         if (*xsink) {
             return nullptr;
         }
-        h->setKeyValue(kstr->c_str(), qv.release(), xsink);
+        h->setKeyValue(kstr.c_str(), qv.release(), xsink);
         assert(!*xsink);
     }
     return h.release();
 }
 
-constexpr int max_array_element = 50000000;
-
-QoreListNode* QoreV8Object::toList(QoreV8ProgramHelper& v8h, v8::Local<v8::Value> parent, v8::Set& objset,
-        v8::Local<v8::Array> props, uint32_t len) const {
+QoreListNode* QoreV8Object::toList(QoreV8ProgramHelper& v8h, v8::Local<v8::Array> array,
+        v8::Local<v8::Value> parent, v8::Set& objset) {
     ExceptionSink* xsink = v8h.getExceptionSink();
-    v8::Local<v8::Object> obj = get();
 
     ReferenceHolder<QoreListNode> l(new QoreListNode(autoTypeInfo), xsink);
-
-    for (uint32_t i = 0, e = len; i < e; ++i) {
-        v8::MaybeLocal<v8::Value> key = props->Get(v8h.getContext(), i);
-        if (key.IsEmpty()) {
-            if (v8h.checkException()) {
-                return nullptr;
-            }
-            continue;
-        }
-        v8::Local<v8::Value> k = key.ToLocalChecked();
-        ValueHolder qk(v8h.getProgram()->getQoreValue(xsink, k), xsink);
-        if (*xsink) {
-            if (v8h.checkException()) {
-                return nullptr;
-            }
-            continue;
-        }
-        int64 ix = qk->getAsBigInt();
-        if (ix > max_array_element) {
-            xsink->raiseException("JAVASCRIPT-ARRAY-ERROR", "The JavaScript object references array element "
-                "%d which is above the max element limit (%d) supported in Qore", ix, max_array_element);
-            return nullptr;
-        }
-        QoreValue& elem = l->getEntryReference(ix);
-
-        v8::MaybeLocal<v8::Value> value = obj->Get(v8h.getContext(), k);
-        if (value.IsEmpty()) {
-            if (v8h.checkException()) {
-                return nullptr;
-            }
-            elem = QoreValue();
-            assert(!*xsink);
-            continue;
-        }
-        v8::Local<v8::Value> v = value.ToLocalChecked();
-        if (v->IsObject()) {
-            v8::MaybeLocal<v8::Object> o = v->ToObject(v8h.getContext());
-            if (o.IsEmpty()) {
-                if (v8h.checkException()) {
-                    return nullptr;
-                }
-                continue;
-            }
-            v8::Local<v8::Object> obj = o.ToLocalChecked();
-            ReferenceHolder<QoreV8Object> tmp(new QoreV8Object(v8h.getProgram(), obj), xsink);
-            ReferenceHolder<AbstractQoreNode> h0(tmp->toData(v8h, parent, objset), xsink);
-            if (*xsink) {
-                return nullptr;
-            }
-            elem = h0.release();
-            continue;
-        }
-        ValueHolder qv(v8h.getProgram()->getQoreValue(xsink, v), xsink);
-        if (*xsink) {
-            return nullptr;
+    if (QoreV8Program::getList(xsink, v8h.getIsolate(), v8h.getContext(), array, *l,
+        [&v8h, parent, &objset] (v8::Local<v8::Value> v) {
+            return toData(v8h, v, parent, objset);
+        })) {
+        if (!*xsink) {
+            v8h.checkException();
         }
-        elem = qv.release();
+        return nullptr;
     }
     return l.release();
 }
@@ -432,6 +466,76 @@ int QoreV8Object::setProperty(QoreV8ProgramHelper& v8h, const char* property, co
     return 0;
 }
 
+QoreHashNode* QoreV8Object::getProperties(QoreV8ProgramHelper& v8h, const QoreListNode* keys, bool paths) {
+    ExceptionSink* xsink = v8h.getExceptionSink();
+    v8::Local<v8::Context> context = v8h.getContext();
+
+    ReferenceHolder<QoreHashNode> rv(new QoreHashNode(autoTypeInfo), xsink);
+    ConstListIterator i(keys);
+    while (i.next()) {
+        TempEncodingHelper str(i.getValue().get<const QoreStringNode>(), QCS_UTF8, xsink);
+        if (*xsink) {
+            return nullptr;
+        }
+        // release the temporary handles for each property
+        v8::HandleScope handle_scope(v8h.getIsolate());
+        v8::Local<v8::String> key;
+        v8::Local<v8::Object> parent = getPathParent(v8h, str->c_str(), paths, key);
+        if (parent.IsEmpty()) {
+            if (*xsink) {
+                return nullptr;
+            }
+            // an intermediate value in the path is not an object
+            rv->setKeyValue(str->c_str(), QoreValue(), xsink);
+            continue;
+        }
+        v8::MaybeLocal<v8::Value> m_val = parent->Get(context, key);
+        if (m_val.IsEmpty()) {
+            v8h.checkException();
+            return nullptr;
+        }
+        ValueHolder v(pgm->getQoreValue(xsink, m_val.ToLocalChecked()), xsink);
+        if (*xsink) {
+            return nullptr;
+        }
+        rv->setKeyValue(str->c_str(), v.release(), xsink);
+    }
+    return rv.release();
+}
+
+int QoreV8Object::setProperties(QoreV8ProgramHelper& v8h, const QoreHashNode* values, bool paths) {
+    ExceptionSink* xsink = v8h.getExceptionSink();
+    v8::Local<v8::Context> context = v8h.getContext();
+
+    ConstHashIterator i(values);
+    while (i.next()) {
+        // release the temporary handles for each property
+        v8::HandleScope handle_scope(v8h.getIsolate());
+        v8::Local<v8::String> key;
+        v8::Local<v8::Object> parent = getPathParent(v8h, i.getKey(), paths, key);
+        if (parent.IsEmpty()) {
+            if (!*xsink) {
+                xsink->raiseException("JAVASCRIPT-SET-PROPERTY-ERROR", "cannot set property '%s'; an intermediate "
+                    "value in the path is not an object", i.getKey());
+            }
+            return -1;
+        }
+        v8::Local<v8::Value> v = pgm->getV8Value(i.get(), xsink);
+        if (*xsink) {
+            return -1;
+        }
+        v8::Maybe<bool> b = parent->Set(context, key, v);
+        if (b.IsNothing()) {
+            if (!v8h.checkException()) {
+                xsink->raiseException("JAVASCRIPT-SET-PROPERTY-ERROR", "Unknown error setting property '%s'",
+                    i.getKey());
+            }
+            return -1;
+        }
+    }
+    return 0;
+}
+
 QoreValue QoreV8Object::getIndexValue(QoreV8ProgramHelper& v8h, int64 i) {
     ExceptionSink* xsink = v8h.getExceptionSink();
     if (i < 0 || i >= UINT_MAX) {
@@ -460,15 +564,19 @@ QoreValue QoreV8Object::callAsFunction(QoreV8ProgramHelper& v8h, const QoreValue
 
 QoreValue QoreV8Object::callAsFunction(QoreV8ProgramHelper& v8h, v8::Local<v8::Value> recv, size_t offset,
         const QoreListNode* args) {
-    ExceptionSink* xsink = v8h.getExceptionSink();
-    QoreV8Program* pgm = v8h.getProgram();
-
     // JavaScript "this" object
     v8::Local<v8::Object> self = get();
     if (!self->IsFunction()) {
-        xsink->raiseException("JAVASCRIPT-ERROR", "This object cannot be called as a function");
+        v8h.getExceptionSink()->raiseException("JAVASCRIPT-ERROR", "This object cannot be called as a function");
         return QoreValue();
     }
+    return callFunction(v8h, self.As<v8::Function>(), recv, offset, args);
+}
+
+QoreValue QoreV8Object::callFunction(QoreV8ProgramHelper& v8h, v8::Local<v8::Function> func,
+        v8::Local<v8::Value> recv, size_t offset, const QoreListNode* args) {
+    ExceptionSink* xsink = v8h.getExceptionSink();
+    QoreV8Program* pgm = v8h.getProgram();
 
     ssize_t size = (args ? args->size() : 0) - offset;
     if (size < 0) {
@@ -493,10 +601,119 @@ QoreValue QoreV8Object::callAsFunction(QoreV8ProgramHelper& v8h, v8::Local<v8::V
 
     v8::Local<v8::Context> ctxt = v8h.getContext();
 
-    v8::MaybeLocal<v8::Value> rv = self->CallAsFunction(ctxt, recv, (int)size, argv.get());
+    v8::MaybeLocal<v8::Value> rv = func->Call(ctxt, recv, (int)size, argv.get());
     if (rv.IsEmpty()) {
         v8h.checkException();
         return QoreValue();
     }
     return pgm->getQoreValue(xsink, rv.ToLocalChecked());
 }
+
+// returns the exception info for a failed call made with callMany()
+static QoreHashNode* get_call_error(ExceptionSink& xsink, size_t index) {
+    ReferenceHolder<QoreHashNode> rv(new QoreHashNode(autoTypeInfo), nullptr);
+    rv->setKeyValue("index", (int64)index, nullptr);
+    rv->setKeyValue("err", xsink.getExceptionErr().refSelf(), nullptr);
+    rv->setKeyValue("desc", xsink.getExceptionDesc().refSelf(), nullptr);
+    rv->setKeyValue("arg", xsink.getExceptionArg().refSelf(), nullptr);
+    xsink.clear();
+    return rv.release();
+}
+
+QoreListNode* QoreV8Object::callMany(QoreV8ProgramHelper& v8h, const QoreListNode* rows, const QoreHashNode* opts) {
+    ExceptionSink* xsink = v8h.getExceptionSink();
+    QoreV8Program* pgm = v8h.getProgram();
+    v8::Isolate* isolate = v8h.getIsolate();
+
+    QoreValue js_this;
+    bool collect_errors = false;
+    if (opts) {
+        ConstHashIterator i(opts);
+        while (i.next()) {
+            if (!strcmp(i.getKey(), "this")) {
+                js_this = i.get();
+            } else if (!strcmp(i.getKey(), "errors")) {
+                collect_errors = i.get().getAsBool();
+            } else {
+                xsink->raiseException("JAVASCRIPT-OPTION-ERROR", "unknown callMany() option '%s'", i.getKey());
+                return nullptr;
+            }
+        }
+    }
+
+    v8::Local<v8::Object> self = get();
+    if (!self->IsFunction()) {
+        xsink->raiseException("JAVASCRIPT-ERROR", "This object cannot be called as a function");
+        return nullptr;
+    }
+    v8::Local<v8::Function> func = self.As<v8::Function>();
+    v8::Local<v8::Context> ctxt = v8h.getContext();
+
+    // the receiver is valid for all calls
+    v8::HandleScope handle_scope(isolate);
+    v8::Local<v8::Value> recv = pgm->getV8Value(js_this, xsink);
+    if (*xsink) {
+        return nullptr;
+    }
+
+    ReferenceHolder<QoreListNode> rv(new QoreListNode(autoTypeInfo), xsink);
+    // the argument buffer is reused for all calls
+    std::vector<v8::Local<v8::Value>> argv;
+
+    size_t size = rows ? rows->size() : 0;
+    for (size_t start = 0; start < size; start += QV8_CALL_MANY_CHUNK) {
+        // temporary handles are released after each chunk of calls
+        v8::HandleScope chunk_scope(isolate);
+        for (size_t i = start, e = std::min(size, start + QV8_CALL_MANY_CHUNK); i < e; ++i) {
+            const QoreValue row = rows->retrieveEntry(i);
+            const QoreListNode* l = row.getType() == NT_LIST ? row.get<const QoreListNode>() : nullptr;
+            size_t argc = l ? l->size() : (row.isNothing() ? 0 : 1);
+            if (argc > argv.size()) {
+                argv.resize(argc);
+            }
+
+            ExceptionSink row_xsink;
+            if (l) {
+                ConstListIterator li(l);
+                while (li.next()) {
+                    argv[li.index()] = pgm->getV8Value(li.getValue(), &row_xsink);
+                    if (row_xsink) {
+                        break;
+                    }
+                }
+            } else if (argc) {
+                argv[0] = pgm->getV8Value(row, &row_xsink);
+            }
+
+            if (!row_xsink) {
+                v8::TryCatch tryCatch(isolate);
+                v8::MaybeLocal<v8::Value> v = func->Call(ctxt, recv, (int)argc, argv.data());
+                if (v.IsEmpty()) {
+                    if (tryCatch.HasTerminated()) {
+                        // execution cannot continue
+                        collect_errors = false;
+                    }
+                    if (!QoreV8Program::checkException(&row_xsink, isolate, tryCatch)) {
+                        row_xsink.raiseException("JAVASCRIPT-ERROR", "Unknown error calling function with row "
+                            "%zu", i);
+                    }
+                } else {
+                    ValueHolder qv(pgm->getQoreValue(&row_xsink, v.ToLocalChecked()), &row_xsink);
+                    if (!row_xsink) {
+                        rv->push(qv.release(), xsink);
+                        continue;
+                    }
+                }
+            }
+
+            assert(row_xsink);
+            if (!collect_errors) {
+                xsink->assimilate(row_xsink);
+                return nullptr;
+            }
+            rv->push(get_call_error(row_xsink, i), xsink);
+        }
+    }
+
+    return rv.release();
+}
@@ -37,6 +37,9 @@
 
 #include <set>
 
+//! The number of calls made in each handle scope by callMany()
+static constexpr size_t QV8_CALL_MANY_CHUNK = 256;
+
 // forward references
 class QoreV8Program;
 class QoreV8ProgramHelper;
@@ -70,6 +73,9 @@ public:
     DLLLOCAL QoreValue callAsFunction(QoreV8ProgramHelper& v8h, v8::Local<v8::Value> recv, size_t offset = 0,
         const QoreListNode* args = nullptr);
 
+    //! Calls the object as a function once for each argument list given
+    DLLLOCAL QoreListNode* callMany(QoreV8ProgramHelper& v8h, const QoreListNode* rows, const QoreHashNode* opts);
+
     DLLLOCAL v8::Local<v8::Object> get() const;
 
     DLLLOCAL v8::Local<v8::Value> get(ExceptionSink* xsink, v8::Isolate* isolate) const;
@@ -80,6 +86,12 @@ public:
 
     DLLLOCAL int setProperty(QoreV8ProgramHelper& v8h, const char* property, const QoreValue value);
 
+    //! Returns a hash of the values of the given properties or property paths
+    DLLLOCAL QoreHashNode* getProperties(QoreV8ProgramHelper& v8h, const QoreListNode* keys, bool paths);
+
+    //! Sets the values of the given properties or property paths
+    DLLLOCAL int setProperties(QoreV8ProgramHelper& v8h, const QoreHashNode* values, bool paths);
+
     DLLLOCAL QoreValue getIndexValue(QoreV8ProgramHelper& v8h, int64 i);
 
     DLLLOCAL QoreListNode* getPropertyList(QoreV8ProgramHelper& v8h);
@@ -89,6 +101,12 @@ public:
 
     DLLLOCAL QoreValue memberGate(ExceptionSink* xsink, const QoreStringNode* m);
 
+    //! Returns the given method; raises a Qore exception and returns an empty handle if not callable
+    DLLLOCAL v8::Local<v8::Function> getMethod(QoreV8ProgramHelper& v8h, const char* name);
+
+    //! Returns a call reference to the given method bound to this object
+    DLLLOCAL ResolvedCallReferenceNode* getBoundMethod(QoreV8ProgramHelper& v8h, const char* name);
+
     DLLLOCAL QoreV8Object* refSelf() const {
         ref();
         return const_cast<QoreV8Object*>(this);
@@ -97,13 +115,32 @@ public:
     DLLLOCAL QoreObject* getReferencedProgram();
 
 protected:
-    DLLLOCAL AbstractQoreNode* toData(QoreV8ProgramHelper& v8h, v8::Local<v8::Value> parent, v8::Set& objset) const;
+    //! Converts the given object to Qore data; returns nullptr if the object has already been converted
+    DLLLOCAL static AbstractQoreNode* toData(QoreV8ProgramHelper& v8h, v8::Local<v8::Object> obj,
+            v8::Local<v8::Value> parent, v8::Set& objset);
+
+    //! Converts the given value to Qore data
+    DLLLOCAL static QoreValue toData(QoreV8ProgramHelper& v8h, v8::Local<v8::Value> val, v8::Local<v8::Value> parent,
+            v8::Set& objset);
+
+    DLLLOCAL static QoreHashNode* toHash(QoreV8ProgramHelper& v8h, v8::Local<v8::Object> obj, v8::Set& objset,
+            v8::Local<v8::Array> props);
+
+    DLLLOCAL static QoreListNode* toList(QoreV8ProgramHelper& v8h, v8::Local<v8::Array> array,
+            v8::Local<v8::Value> parent, v8::Set& objset);
+
+    //! Returns an internalized string for the given property name from the program's key cache
+    DLLLOCAL v8::Local<v8::String> getKey(QoreV8ProgramHelper& v8h, const char* name, size_t len);
 
-    DLLLOCAL QoreHashNode* toHash(QoreV8ProgramHelper& v8h, v8::Local<v8::Value> parent, v8::Set& objset,
-            v8::Local<v8::Array> props, uint32_t len) const;
+    //! Returns the object holding the last element of the given path and sets the last key
+    /** returns an empty handle if an intermediate value is not an object or if an exception is raised
+    */
+    DLLLOCAL v8::Local<v8::Object> getPathParent(QoreV8ProgramHelper& v8h, const char* path, bool paths,
+            v8::Local<v8::String>& key);
 
-    DLLLOCAL QoreListNode* toList(QoreV8ProgramHelper& v8h, v8::Local<v8::Value> parent, v8::Set& objset,
-            v8::Local<v8::Array> props, uint32_t len) const;
+    //! Calls the given function with the given receiver and arguments
+    DLLLOCAL static QoreValue callFunction(QoreV8ProgramHelper& v8h, v8::Local<v8::Function> func,
+            v8::Local<v8::Value> recv, size_t offset, const QoreListNode* args);
 
     QoreV8Program* pgm;
     v8::Global<v8::Object> obj;
@@ -26,6 +26,7 @@
 #include "QC_JavaScriptPromise.h"
 #include "QoreV8Program.h"
 #include "QoreV8StackLocationHelper.h"
+#include "QoreV8CodeCache.h"
 
 #include <uv.h>
 
@@ -33,22 +34,34 @@
 #include <string>
 #include <memory>
 #include <climits>
+#include <cmath>
 
 QoreThreadLock QoreV8Program::global_lock;
 QoreV8Program::pset_t QoreV8Program::pset;
-QoreString QoreV8Program::scont("\\n");
 
-QoreV8Program::QoreV8Program() : save_ref_callback(nullptr) {
+QoreV8Program::QoreV8Program(QoreV8Snapshot* snapshot) : snapshot(snapshot), save_ref_callback(nullptr) {
     //printd(5, "QoreV8Program::QoreV8Program() this: %p\n", this);
     // Setup up a libuv event loop, v8::Isolate, and Node.js Environment.
     // setup common environment
     std::vector<std::string> errors;
-    setup = node::CommonEnvironmentSetup::Create(platform.get(), &errors, init_result->args(),
-        init_result->exec_args(), node::EnvironmentFlags::kNoCreateInspector);
+    if (snapshot) {
+        // the snapshot data must stay valid as long as the isolate exists
+        snapshot->ref();
+#ifdef QORE_V8_HAVE_SNAPSHOTS
+        setup = node::CommonEnvironmentSetup::CreateFromSnapshot(platform.get(), &errors, snapshot->get(),
+            init_result->args(), init_result->exec_args(), node::EnvironmentFlags::kNoCreateInspector);
+#else
+        assert(false);
+#endif
+    } else {
+        setup = node::CommonEnvironmentSetup::Create(platform.get(), &errors, init_result->args(),
+            init_result->exec_args(), node::EnvironmentFlags::kNoCreateInspector);
+    }
     if (!setup) {
         for (const std::string& err : errors) {
             fprintf(stderr, "v8 module init error: %s: %s\n", init_result->args()[0].c_str(), err.c_str());
         }
+        valid = false;
         return;
     }
 
@@ -59,22 +72,36 @@ QoreV8Program::QoreV8Program() : save_ref_callback(nullptr) {
     assert(env);
 }
 
-QoreV8Program::QoreV8Program(const QoreString& source_code, const QoreString& source_label, ExceptionSink* xsink)
-        : QoreV8Program() {
+QoreV8Program::QoreV8Program(const QoreString& source_code, const QoreString& source_label, ExceptionSink* xsink,
+        const QoreString* require_dir) : QoreV8Program() {
     assert(source_code.getEncoding() == QCS_UTF8);
     assert(source_label.getEncoding() == QCS_UTF8);
 
     source = source_code;
     label = source_label;
-    escapeSingle(source);
-    escapeSingle(label);
+    if (require_dir) {
+        this->require_dir = *require_dir;
+    }
+
+    init(xsink);
+}
+
+QoreV8Program::QoreV8Program(QoreV8Snapshot* snapshot, ExceptionSink* xsink, const QoreString* require_dir)
+        : QoreV8Program(snapshot) {
+    label = snapshot->getLabel();
+    if (require_dir) {
+        this->require_dir = *require_dir;
+    }
 
     init(xsink);
 }
 
-QoreV8Program::QoreV8Program(ExceptionSink* xsink, const QoreV8Program& old, QoreObject* self) : QoreV8Program() {
+QoreV8Program::QoreV8Program(ExceptionSink* xsink, const QoreV8Program& old, QoreObject* self)
+        : QoreV8Program(old.snapshot) {
     source = old.source;
     label = old.label;
+    require_dir = old.require_dir;
+    conv_opts = old.conv_opts.load();
 
     if (!init(xsink)) {
         this->self = self;
@@ -89,10 +116,20 @@ QoreV8Program::~QoreV8Program() {
     //printd(5, "QoreV8Program::~QoreV8Program() this: %p\n", this);
     assert(!weakRefs.reference_count());
 
-    AutoLocker al(global_lock);
-    pset_t::iterator i = pset.find(this);
-    if (i != pset.end()) {
-        pset.erase(i);
+    {
+        AutoLocker al(global_lock);
+        pset_t::iterator i = pset.find(this);
+        if (i != pset.end()) {
+            pset.erase(i);
+        }
+    }
+
+    delete event_loop.load();
+
+    // release the environment before the snapshot data it was created from
+    setup.reset();
+    if (snapshot) {
+        snapshot->deref();
     }
 }
 
@@ -120,10 +157,18 @@ int QoreV8Program::init(ExceptionSink* xsink) {
         // `module.createRequire()` is being used to create one that is able to
         // load files from the disk, and uses the standard CommonJS file loader
         // instead of the internal-only `require` function.
-        QoreStringMaker envstr("const publicRequire = require('module').createRequire(process.cwd() + '/');\n"
-            "globalThis.require = publicRequire;\n"
-            "publicRequire('node:vm').runInThisContext('%s', {'filename': '%s'});", source.c_str(), label.c_str());
-        v8::MaybeLocal<v8::Value> loadenv_ret = node::LoadEnvironment(env, envstr.c_str());
+        v8::MaybeLocal<v8::Value> loadenv_ret;
+        if (snapshot) {
+#ifdef QORE_V8_HAVE_SNAPSHOTS
+            // the source has already been run in the snapshot; this runs the deserialize main function which
+            // sets up the public require() function
+            loadenv_ret = node::LoadEnvironment(env, node::StartExecutionCallback{});
+#endif
+        } else {
+            loadenv_ret = node::LoadEnvironment(env,
+                "const publicRequire = require('module').createRequire(process.cwd() + '/');\n"
+                "globalThis.require = publicRequire;\n");
+        }
         valid = !loadenv_ret.IsEmpty();
         if (!valid) {
             if (!checkException(xsink, tryCatch)) {
@@ -132,6 +177,18 @@ int QoreV8Program::init(ExceptionSink* xsink) {
             return -1;
         }
 
+        // create the public require() function relative to the given directory
+        if (!require_dir.empty() && setRequireDir(xsink, setup->context(), tryCatch)) {
+            valid = false;
+            return -1;
+        }
+
+        // the source is compiled and run directly in the main context
+        if (!snapshot && runSource(xsink, isolate, setup->context(), source, label, tryCatch)) {
+            valid = false;
+            return -1;
+        }
+
         global.Reset(isolate, setup->context()->Global());
     }
 
@@ -141,23 +198,110 @@ int QoreV8Program::init(ExceptionSink* xsink) {
     return 0;
 }
 
-void QoreV8Program::escapeSingle(QoreString& str) {
-    ExceptionSink xsink;
-    for (size_t i = 0; i < str.size(); ++i) {
-        switch (str[i]) {
-            case '\\':
-            case '\'':
-                str.insertch('\\', i, 1);
-                ++i;
-                break;
+int QoreV8Program::setRequireDir(ExceptionSink* xsink, v8::Local<v8::Context> context,
+        const v8::TryCatch& tryCatch) {
+    v8::Local<v8::Value> func;
+    {
+        v8::MaybeLocal<v8::String> str = v8::String::NewFromUtf8(isolate, "(function (dir) { globalThis.require = "
+            "globalThis.require('module').createRequire(dir + '/'); })", v8::NewStringType::kNormal);
+        v8::Local<v8::Script> script;
+        if (str.IsEmpty() || !v8::Script::Compile(context, str.ToLocalChecked()).ToLocal(&script)
+            || !script->Run(context).ToLocal(&func) || !func->IsFunction()) {
+            if (!checkException(xsink, tryCatch)) {
+                xsink->raiseException("JAVASCRIPT-PROGRAM-ERROR", "Unknown error setting the require() directory");
+            }
+            return -1;
+        }
+    }
 
-            case '\n':
-                str.splice(str.getByteOffset(i, &xsink), 1, scont, &xsink);
-                assert(!xsink);
-                i += (scont.size() - 1);
-                break;
+    v8::MaybeLocal<v8::String> dir = v8::String::NewFromUtf8(isolate, require_dir.c_str(),
+        v8::NewStringType::kNormal, (int)require_dir.size());
+    if (dir.IsEmpty()) {
+        checkException(xsink, tryCatch);
+        return -1;
+    }
+    v8::Local<v8::Value> argv[] = { dir.ToLocalChecked() };
+    if (func.As<v8::Function>()->Call(context, context->Global(), 1, argv).IsEmpty()) {
+        if (!checkException(xsink, tryCatch)) {
+            xsink->raiseException("JAVASCRIPT-PROGRAM-ERROR", "Unknown error setting the require() directory to "
+                "'%s'", require_dir.c_str());
+        }
+        return -1;
+    }
+    return 0;
+}
+
+int QoreV8Program::runSource(ExceptionSink* xsink, v8::Isolate* isolate, v8::Local<v8::Context> context,
+        const QoreString& source, const QoreString& label, const v8::TryCatch& tryCatch, bool use_cache) {
+    v8::MaybeLocal<v8::String> src = v8::String::NewFromUtf8(isolate, source.c_str(), v8::NewStringType::kNormal,
+        (int)source.size());
+    v8::MaybeLocal<v8::String> name = v8::String::NewFromUtf8(isolate, label.c_str(), v8::NewStringType::kNormal,
+        (int)label.size());
+    if (src.IsEmpty() || name.IsEmpty()) {
+        if (!checkException(xsink, isolate, tryCatch)) {
+            xsink->raiseException("JAVASCRIPT-PROGRAM-ERROR", "Could not create JavaScript source string");
+        }
+        return -1;
+    }
+
+#if V8_MAJOR_VERSION >= 12
+    v8::ScriptOrigin origin(name.ToLocalChecked());
+#else
+    v8::ScriptOrigin origin(isolate, name.ToLocalChecked());
+#endif
+
+    // use cached compilation data for the source, if available
+    std::string key;
+    QoreV8CodeCache::data_t cache_data;
+    if (use_cache) {
+        key = QoreV8CodeCache::getKey(source);
+        cache_data = QoreV8CodeCache::get(key);
+    }
+    v8::ScriptCompiler::CachedData* cached = cache_data
+        ? new v8::ScriptCompiler::CachedData(reinterpret_cast<const uint8_t*>(cache_data->data()),
+            (int)cache_data->size())
+        : nullptr;
+
+    // the source object takes ownership of the cached data object, but not of the buffer
+    v8::ScriptCompiler::Source script_source(src.ToLocalChecked(), origin, cached);
+    v8::MaybeLocal<v8::Script> script = v8::ScriptCompiler::Compile(context, &script_source,
+        cached ? v8::ScriptCompiler::kConsumeCodeCache : v8::ScriptCompiler::kNoCompileOptions);
+    if (script.IsEmpty()) {
+        if (!checkException(xsink, isolate, tryCatch)) {
+            xsink->raiseException("JAVASCRIPT-PROGRAM-ERROR", "Unknown error compiling program");
+        }
+        return -1;
+    }
+
+    bool produce = use_cache && !cached;
+    if (cached) {
+        if (script_source.GetCachedData()->rejected) {
+            QoreV8CodeCache::reject(key);
+            produce = true;
+        } else {
+            QoreV8CodeCache::hit();
         }
     }
+
+    v8::Local<v8::Script> s = script.ToLocalChecked();
+    if (s->Run(context).IsEmpty()) {
+        if (!checkException(xsink, isolate, tryCatch)) {
+            xsink->raiseException("JAVASCRIPT-PROGRAM-ERROR", "Unknown error running program");
+        }
+        return -1;
+    }
+
+    if (produce) {
+        // the cache is created after the script has been run, so that it also includes functions compiled lazily
+        // while running it
+        std::unique_ptr<v8::ScriptCompiler::CachedData> data(
+            v8::ScriptCompiler::CreateCodeCache(s->GetUnboundScript()));
+        if (data && data->length) {
+            QoreV8CodeCache::put(key, data->data, data->length);
+        }
+    }
+
+    return 0;
 }
 
 void QoreV8Program::shutdown() {
@@ -168,6 +312,81 @@ void QoreV8Program::shutdown() {
     }
 }
 
+thread_local QoreV8ProgramSession* QoreV8ProgramSession::current = nullptr;
+
+int QoreV8Program::beginOperation(ExceptionSink* xsink, bool silent) {
+    AutoLocker al(m);
+    if (!valid) {
+        if (!silent) {
+            xsink->raiseException("JAVASCRIPT-PROGRAM-ERROR", "The given JavaScriptProgram has been destroyed "
+                "and can no longer be accessed");
+        }
+        return -1;
+    }
+    if (to_destroy) {
+        if (!silent) {
+            xsink->raiseException("JAVASCRIPT-PROGRAM-ERROR", "The given JavaScriptProgram has been marked for "
+                "destruction and can no longer be accessed");
+        }
+        return -1;
+    }
+    ++opcount;
+    return 0;
+}
+
+void QoreV8Program::endOperation(ExceptionSink* xsink) {
+    AutoLocker al(m);
+    if (!--opcount) {
+        if (to_destroy) {
+            destructor(xsink);
+        } else {
+            // the isolate is still locked, and no conversion is in progress after the outermost operation
+            trimCaches();
+        }
+    }
+}
+
+QoreValue QoreV8Program::runInSession(ExceptionSink* xsink, const ResolvedCallReferenceNode* code,
+        const QoreListNode* args) {
+    QoreV8ProgramSession session(xsink, this);
+    if (!session) {
+        return QoreValue();
+    }
+    return code->execValue(args, xsink);
+}
+
+int QoreV8Program::startEventLoopThread(ExceptionSink* xsink) {
+    AutoLocker al(m);
+    if (!valid || to_destroy) {
+        xsink->raiseException("JAVASCRIPT-PROGRAM-ERROR", "The given JavaScriptProgram has been destroyed "
+            "and can no longer be accessed");
+        return -1;
+    }
+    QoreV8EventLoop* el = event_loop.load(std::memory_order_acquire);
+    if (!el) {
+        el = new QoreV8EventLoop(this);
+        event_loop.store(el, std::memory_order_release);
+    }
+    return el->start(xsink);
+}
+
+void QoreV8Program::stopEventLoopThread() {
+    QoreV8EventLoop* el = event_loop.load(std::memory_order_acquire);
+    if (el) {
+        el->stop();
+    }
+}
+
+QoreValue QoreV8Program::runInEventLoop(ExceptionSink* xsink, const ResolvedCallReferenceNode* code,
+        const QoreListNode* args) {
+    QoreV8EventLoop* el = event_loop.load(std::memory_order_acquire);
+    if (!el) {
+        xsink->raiseException("JAVASCRIPT-EVENT-LOOP-ERROR", "the event loop thread has not been started");
+        return QoreValue();
+    }
+    return el->run(xsink, code, args);
+}
+
 void QoreV8Program::deleteIntern(ExceptionSink* xsink) {
     printd(5, "QoreV8Program::deleteIntern() this: %p\n", this);
     {
@@ -188,14 +407,51 @@ void QoreV8Program::deleteIntern(ExceptionSink* xsink) {
             save_ref_callback.release()->deref(xsink);
         }
     }
+    stopEventLoopThread();
     if (env) {
         node::Stop(env);
         env = nullptr;
     }
+    closeAsyncCalls(xsink);
     global.Reset();
+    hash_proxy_tmpl.Reset();
+    list_proxy_tmpl.Reset();
+    class_cache.clear();
+    qore_object_tmpl.Reset();
+    shape_cache.clear();
+    shape_candidates.clear();
+    key_cache.clear();
+    clearCallbackCache(callback_cache);
+    clearCallbackCache(async_callback_cache);
+    clearSavedReferences(xsink);
+    for (QoreV8TypedFunction* tf : typed_functions) {
+        tf->release(xsink);
+        delete tf;
+    }
+    typed_functions.clear();
+}
+
+// releases the saved reference outside of garbage collection, as releasing it can run Qore destructors; the
+// reference has already been detached from the program, which may have been deleted in the meantime
+static void saved_ref_release(const v8::WeakCallbackInfo<QoreV8SavedReference>& data) {
+    QoreV8SavedReference* ref = data.GetParameter();
+    ExceptionSink xsink;
+    ref->val.discard(&xsink);
+    delete ref;
+    // exceptions raised in destructors cannot be propagated from the garbage collector
+    xsink.clear();
 }
 
-int QoreV8Program::saveQoreReference(const QoreValue& rv, ExceptionSink& xsink) {
+static void saved_ref_weak_callback(const v8::WeakCallbackInfo<QoreV8SavedReference>& data) {
+    QoreV8SavedReference* ref = data.GetParameter();
+    ref->holder.Reset();
+    // detach the reference here so that it cannot be freed with the program before the second pass runs
+    ref->pgm->detachSavedReference(ref);
+    ref->pgm = nullptr;
+    data.SetSecondPassCallback(saved_ref_release);
+}
+
+int QoreV8Program::saveQoreReference(const QoreValue& rv, v8::Local<v8::Value> holder, ExceptionSink& xsink) {
     {
         qore_type_t t = rv.getType();
         if (t != NT_OBJECT && t != NT_RUNTIME_CLOSURE && t != NT_FUNCREF) {
@@ -221,54 +477,36 @@ int QoreV8Program::saveQoreReference(const QoreValue& rv, ExceptionSink& xsink)
         return 0;
     }
 
-    return saveQoreReferenceDefault(rv, xsink);
+    holdQoreReference(rv, holder);
+    return 0;
 }
 
-int QoreV8Program::saveQoreReferenceDefault(const QoreValue& rv, ExceptionSink& xsink) {
-    QoreHashNode* data = qpgm->getThreadData();
-    assert(data);
-    const char* domain_name;
-    // get key name where to save the data if possible
-    QoreValue v = data->getKeyValue("_v8_save");
-    if (v.getType() != NT_STRING) {
-        domain_name = "_v8_save";
-    } else {
-        domain_name = v.get<const QoreStringNode>()->c_str();
-    }
-
-    QoreValue kv = data->getKeyValue(domain_name);
-    // ignore operation if domain exists but is not a list
-    if (!kv || kv.getType() == NT_LIST) {
-        QoreListNode* list;
-        ReferenceHolder<QoreListNode> list_holder(&xsink);
-        if (!kv) {
-            // we need to assign list in data *after* we prepend the object to the list
-            // in order to manage object counts
-            list = new QoreListNode(autoTypeInfo);
-            list_holder = list;
-        } else {
-            list = kv.get<QoreListNode>();
-        }
+void QoreV8Program::holdQoreReference(const QoreValue& rv, v8::Local<v8::Value> holder) {
+    // the reference is released when the holder is collected
+    QoreV8SavedReference* ref = new QoreV8SavedReference(this, rv.refSelf());
+    ref->holder.Reset(isolate, holder);
+    ref->holder.SetWeak(ref, saved_ref_weak_callback, v8::WeakCallbackType::kParameter);
+    saved_refs.insert(ref);
+    ++saved_ref_count;
+}
 
-        // prepend to list to ensure FILO destruction order
-        list->splice(0, 0, rv, &xsink);
-        if (!xsink && list_holder) {
-            data->setKeyValue(domain_name, list_holder.release(), &xsink);
-        }
-        if (xsink) {
-            raiseV8Exception(xsink, isolate);
-            return -1;
-        }
-        //printd(5, "saveQoreReferenceDefault() domain: '%s' obj: %p %s\n", domain_name, rv.get<QoreObject>(),
-        //    rv.get<QoreObject>()->getClassName());
-    } else {
-        //printd(5, "saveQoreReferenceDefault() NOT SAVING domain: '%s' HAS KEY v: %s (kv: %s)\n", domain_name,
-        //    rv.getFullTypeName(), kv.getFullTypeName());
+void QoreV8Program::detachSavedReference(QoreV8SavedReference* ref) {
+    if (saved_refs.erase(ref)) {
+        --saved_ref_count;
     }
-    return 0;
 }
 
-int QoreV8Program::checkException(ExceptionSink* xsink, const v8::TryCatch& tryCatch) const {
+void QoreV8Program::clearSavedReferences(ExceptionSink* xsink) {
+    for (QoreV8SavedReference* ref : saved_refs) {
+        ref->holder.Reset();
+        ref->val.discard(xsink);
+        delete ref;
+    }
+    saved_refs.clear();
+    saved_ref_count.store(0);
+}
+
+int QoreV8Program::checkException(ExceptionSink* xsink, v8::Isolate* isolate, const v8::TryCatch& tryCatch) {
     if (tryCatch.HasCaught()) {
         v8::Local<v8::Value> ex = tryCatch.Exception();
         if (!*ex) {
@@ -314,6 +552,923 @@ int QoreV8Program::checkException(ExceptionSink* xsink, const v8::TryCatch& tryC
     return 0;
 }
 
+// the maximum list element index supported
+constexpr uint32_t max_array_element = 50000000;
+// arrays at least this long are checked for sparse elements before being converted
+constexpr uint32_t sparse_array_threshold = 1 << 20;
+// the number of evenly spaced elements checked to determine if a large array may be sparse
+constexpr uint32_t sparse_array_samples = 32;
+
+// converts values that do not require calling into V8; returns false if the value must be converted otherwise
+static bool get_primitive_value(v8::Local<v8::Value> v, QoreValue& rv) {
+    if (v->IsInt32()) {
+        rv = (int64)v.As<v8::Int32>()->Value();
+        return true;
+    }
+    if (v->IsUint32()) {
+        rv = (int64)v.As<v8::Uint32>()->Value();
+        return true;
+    }
+    if (v->IsNumber()) {
+        rv = v.As<v8::Number>()->Value();
+        return true;
+    }
+    if (v->IsBoolean()) {
+        rv = v.As<v8::Boolean>()->Value();
+        return true;
+    }
+    if (v->IsNullOrUndefined()) {
+        rv = QoreValue();
+        return true;
+    }
+    return false;
+}
+
+#if V8_MAJOR_VERSION >= 12
+struct QoreV8ArrayIterateInfo {
+    QoreListNode* l;
+    // indexes of elements that must be converted after iteration
+    std::vector<uint32_t> deferred;
+};
+
+// v8::Array::Iterate() callback; must not allocate V8 objects or call into V8
+static v8::Array::CallbackResult array_iterate_element(uint32_t index, v8::Local<v8::Value> element, void* data) {
+    QoreV8ArrayIterateInfo* info = reinterpret_cast<QoreV8ArrayIterateInfo*>(data);
+    QoreValue v;
+    if (get_primitive_value(element, v)) {
+        info->l->getEntryReference(index) = v;
+    } else {
+        info->deferred.push_back(index);
+    }
+    return v8::Array::CallbackResult::kContinue;
+}
+#endif
+
+// converts a single array element to the given list entry
+static int get_array_element(ExceptionSink* xsink, v8::Local<v8::Context> context, v8::Local<v8::Array> array,
+        v8::Local<v8::Value> key, uint32_t index, QoreListNode* l,
+        const std::function<QoreValue(v8::Local<v8::Value>)>& conv) {
+    v8::MaybeLocal<v8::Value> val = key.IsEmpty() ? array->Get(context, index) : array->Get(context, key);
+    if (val.IsEmpty()) {
+        return -1;
+    }
+    v8::Local<v8::Value> v = val.ToLocalChecked();
+    QoreValue qv;
+    if (!get_primitive_value(v, qv)) {
+        qv = conv(v);
+        if (*xsink) {
+            qv.discard(xsink);
+            return -1;
+        }
+    }
+    l->getEntryReference(index) = qv;
+    return 0;
+}
+
+// returns 1 if any of a sample of elements of the array is a hole, 0 if not, or -1 if an exception was raised
+static int array_sample_holes(v8::Local<v8::Context> context, v8::Local<v8::Array> array, uint32_t len) {
+    uint32_t step = len / sparse_array_samples;
+    for (uint32_t i = 0; i < sparse_array_samples; ++i) {
+        // always check the last element, which exists in dense arrays
+        uint32_t ix = i == sparse_array_samples - 1 ? len - 1 : i * step;
+        v8::Maybe<bool> has = array->HasRealIndexedProperty(context, ix);
+        if (has.IsNothing()) {
+            return -1;
+        }
+        if (!has.FromJust()) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int QoreV8Program::getList(ExceptionSink* xsink, v8::Isolate* isolate, v8::Local<v8::Context> context,
+        v8::Local<v8::Array> array, QoreListNode* l, const std::function<QoreValue(v8::Local<v8::Value>)>& conv) {
+    assert(l->empty());
+    uint32_t len = array->Length();
+    if (!len) {
+        return 0;
+    }
+
+    if (len >= sparse_array_threshold) {
+        // only enumerate the keys of arrays that may be sparse; dense arrays are converted directly
+        int rc = array_sample_holes(context, array, len);
+        if (rc < 0) {
+            return -1;
+        }
+        if (rc) {
+            v8::MaybeLocal<v8::Array> maybe_keys = array->GetOwnPropertyNames(context,
+                static_cast<v8::PropertyFilter>(v8::ONLY_ENUMERABLE | v8::SKIP_SYMBOLS),
+                v8::KeyConversionMode::kKeepNumbers);
+            if (maybe_keys.IsEmpty()) {
+                return -1;
+            }
+            v8::Local<v8::Array> keys = maybe_keys.ToLocalChecked();
+            uint32_t count = keys->Length();
+            if (count < len / 2) {
+                // sparse array: only convert existing elements; the list ends with the highest index
+                for (uint32_t i = 0; i < count; ++i) {
+                    v8::HandleScope handle_scope(isolate);
+                    v8::MaybeLocal<v8::Value> maybe_key = keys->Get(context, i);
+                    if (maybe_key.IsEmpty()) {
+                        return -1;
+                    }
+                    v8::Local<v8::Value> key = maybe_key.ToLocalChecked();
+                    if (!key->IsUint32()) {
+                        continue;
+                    }
+                    uint32_t ix = key.As<v8::Uint32>()->Value();
+                    if (ix > max_array_element) {
+                        xsink->raiseException("JAVASCRIPT-ARRAY-ERROR", "The JavaScript object references array "
+                            "element %u which is above the max element limit (%u) supported in Qore", ix,
+                            max_array_element);
+                        return -1;
+                    }
+                    if (get_array_element(xsink, context, array, key, ix, l, conv)) {
+                        return -1;
+                    }
+                }
+                return 0;
+            }
+        }
+    }
+
+    if (len > max_array_element) {
+        xsink->raiseException("JAVASCRIPT-ARRAY-ERROR", "The JavaScript array has %u elements, which is above the "
+            "max element limit (%u) supported in Qore", len, max_array_element);
+        return -1;
+    }
+
+    // preallocate the list
+    l->getEntryReference(len - 1);
+
+#if V8_MAJOR_VERSION >= 12
+    // convert primitive elements in bulk, and then the remaining elements by index
+    QoreV8ArrayIterateInfo info = {l};
+    if (array->Iterate(context, array_iterate_element, &info).IsNothing()) {
+        return -1;
+    }
+    for (uint32_t ix : info.deferred) {
+        v8::HandleScope handle_scope(isolate);
+        if (get_array_element(xsink, context, array, v8::Local<v8::Value>(), ix, l, conv)) {
+            return -1;
+        }
+    }
+#else
+    for (uint32_t i = 0; i < len; ++i) {
+        v8::HandleScope handle_scope(isolate);
+        if (get_array_element(xsink, context, array, v8::Local<v8::Value>(), i, l, conv)) {
+            return -1;
+        }
+    }
+#endif
+    return 0;
+}
+
+int QoreV8Program::getHash(ExceptionSink* xsink, v8::Isolate* isolate, v8::Local<v8::Context> context,
+        v8::Local<v8::Map> map, QoreHashNode* h, const std::function<QoreValue(v8::Local<v8::Value>)>& conv) {
+    assert(h->empty());
+    // the array contains the keys and values of all entries in insertion order
+    v8::Local<v8::Array> entries = map->AsArray();
+    uint32_t len = entries->Length();
+    QoreString kstr(QCS_UTF8);
+    for (uint32_t i = 0; i < len; i += 2) {
+        v8::HandleScope handle_scope(isolate);
+        v8::MaybeLocal<v8::Value> maybe_key = entries->Get(context, i);
+        if (maybe_key.IsEmpty()) {
+            return -1;
+        }
+        v8::Local<v8::Value> key = maybe_key.ToLocalChecked();
+        if (key->IsUint32()) {
+            kstr.clear();
+            kstr.sprintf("%u", key.As<v8::Uint32>()->Value());
+        } else if (key->IsString() || key->IsNumber()) {
+            v8::String::Utf8Value utf8(isolate, key);
+            kstr.clear();
+            kstr.concat(*utf8, utf8.length());
+        } else {
+            return 1;
+        }
+        // different keys like 1 and "1" would be converted to the same hash key
+        if (h->existsKey(kstr.c_str())) {
+            return 1;
+        }
+
+        v8::MaybeLocal<v8::Value> maybe_val = entries->Get(context, i + 1);
+        if (maybe_val.IsEmpty()) {
+            return -1;
+        }
+        ValueHolder v(conv(maybe_val.ToLocalChecked()), xsink);
+        if (*xsink) {
+            return -1;
+        }
+        h->setKeyValue(kstr, v.release(), xsink);
+    }
+    return 0;
+}
+
+// creates a typed list from typed array data; T is the array element type, Q is the Qore value type
+template <typename T, typename Q>
+static QoreListNode* make_typed_list(const QoreTypeInfo* typeInfo, const void* data, size_t len) {
+    const T* p = reinterpret_cast<const T*>(data);
+    QoreListNode* l = new QoreListNode(typeInfo);
+    if (len) {
+        l->getEntryReference(len - 1);
+        for (size_t i = 0; i < len; ++i) {
+            l->getEntryReference(i) = (Q)p[i];
+        }
+    }
+    return l;
+}
+
+// returns a list for a numeric typed array, or nullptr if the array should be converted to a binary value
+static QoreListNode* get_typed_array_list(v8::Local<v8::TypedArray> ta) {
+    if (ta->IsUint8Array() || ta->IsUint8ClampedArray()) {
+        return nullptr;
+    }
+    size_t len = ta->Length();
+    const void* data = nullptr;
+    if (len) {
+        data = reinterpret_cast<const char*>(ta->Buffer()->GetBackingStore()->Data()) + ta->ByteOffset();
+    }
+    if (ta->IsFloat64Array()) {
+        return make_typed_list<double, double>(floatTypeInfo, data, len);
+    }
+    if (ta->IsFloat32Array()) {
+        return make_typed_list<float, double>(floatTypeInfo, data, len);
+    }
+    if (ta->IsInt32Array()) {
+        return make_typed_list<int32_t, int64>(bigIntTypeInfo, data, len);
+    }
+    if (ta->IsUint32Array()) {
+        return make_typed_list<uint32_t, int64>(bigIntTypeInfo, data, len);
+    }
+    if (ta->IsInt16Array()) {
+        return make_typed_list<int16_t, int64>(bigIntTypeInfo, data, len);
+    }
+    if (ta->IsUint16Array()) {
+        return make_typed_list<uint16_t, int64>(bigIntTypeInfo, data, len);
+    }
+    if (ta->IsInt8Array()) {
+        return make_typed_list<int8_t, int64>(bigIntTypeInfo, data, len);
+    }
+    if (ta->IsBigInt64Array()) {
+        return make_typed_list<int64_t, int64>(bigIntTypeInfo, data, len);
+    }
+    if (ta->IsBigUint64Array()) {
+        const uint64_t* p = reinterpret_cast<const uint64_t*>(data);
+        bool big = false;
+        for (size_t i = 0; i < len; ++i) {
+            if (p[i] > (uint64_t)LLONG_MAX) {
+                big = true;
+                break;
+            }
+        }
+        if (!big) {
+            return make_typed_list<int64_t, int64>(bigIntTypeInfo, data, len);
+        }
+        // values that do not fit in an int are returned as numbers
+        ReferenceHolder<QoreListNode> l(new QoreListNode(autoTypeInfo), nullptr);
+        l->getEntryReference(len - 1);
+        for (size_t i = 0; i < len; ++i) {
+            if (p[i] > (uint64_t)LLONG_MAX) {
+                QoreString str;
+                str.sprintf("%llu", (unsigned long long)p[i]);
+                l->getEntryReference(i) = new QoreNumberNode(str.c_str());
+            } else {
+                l->getEntryReference(i) = (int64)p[i];
+            }
+        }
+        return l.release();
+    }
+    return nullptr;
+}
+
+// returns a typed array for a non-empty homogeneous list of ints or floats, or an empty handle if not possible;
+// the typed array type for int lists depends on the range of the values (see the typed_arrays option)
+static v8::Local<v8::Value> get_typed_array(v8::Isolate* isolate, const QoreListNode* l) {
+    size_t len = l->size();
+    qore_type_t t = l->retrieveEntry(0).getType();
+    if (t != NT_INT && t != NT_FLOAT) {
+        return v8::Local<v8::Value>();
+    }
+    int64 min = 0, max = 0;
+    for (size_t i = 0; i < len; ++i) {
+        QoreValue v = l->retrieveEntry(i);
+        if (v.getType() != t) {
+            return v8::Local<v8::Value>();
+        }
+        if (t == NT_INT) {
+            int64 iv = v.getAsBigInt();
+            if (iv < min) {
+                min = iv;
+            } else if (iv > max) {
+                max = iv;
+            }
+        }
+    }
+
+    if (t == NT_INT && min >= INT_MIN && max <= INT_MAX) {
+        v8::Local<v8::ArrayBuffer> ab = v8::ArrayBuffer::New(isolate, len * sizeof(int32_t));
+        int32_t* p = reinterpret_cast<int32_t*>(ab->GetBackingStore()->Data());
+        for (size_t i = 0; i < len; ++i) {
+            p[i] = (int32_t)l->retrieveEntry(i).getAsBigInt();
+        }
+        return v8::Int32Array::New(ab, 0, len);
+    }
+
+    // integers outside of the range that can be represented exactly by a double are sent as BigInts
+    static constexpr int64 max_safe_int = (1LL << 53) - 1;
+    if (t == NT_INT && (min < -max_safe_int || max > max_safe_int)) {
+        v8::Local<v8::ArrayBuffer> ab = v8::ArrayBuffer::New(isolate, len * sizeof(int64_t));
+        int64_t* p = reinterpret_cast<int64_t*>(ab->GetBackingStore()->Data());
+        for (size_t i = 0; i < len; ++i) {
+            p[i] = l->retrieveEntry(i).getAsBigInt();
+        }
+        return v8::BigInt64Array::New(ab, 0, len);
+    }
+
+    v8::Local<v8::ArrayBuffer> ab = v8::ArrayBuffer::New(isolate, len * sizeof(double));
+    double* p = reinterpret_cast<double*>(ab->GetBackingStore()->Data());
+    for (size_t i = 0; i < len; ++i) {
+        p[i] = l->retrieveEntry(i).getAsFloat();
+    }
+    return v8::Float64Array::New(ab, 0, len);
+}
+
+// the maximum number of cached key strings
+static constexpr size_t max_key_cache_size = 16384;
+// the maximum number of cached object shapes
+static constexpr size_t max_shape_cache_size = 1024;
+// the maximum number of key sequences seen once that are remembered
+static constexpr size_t max_shape_candidates = 4096;
+// the maximum number of keys in a hash for its shape to be cached
+static constexpr size_t max_shape_keys = 64;
+
+v8::MaybeLocal<v8::String> QoreV8Program::getKeyString(const char* key, size_t len) {
+    auto i = key_cache.find(std::string_view(key, len));
+    if (i != key_cache.end()) {
+        return i->second->str.Get(isolate);
+    }
+    v8::MaybeLocal<v8::String> rv = v8::String::NewFromUtf8(isolate, key, v8::NewStringType::kInternalized,
+        (int)len);
+    // the cache may grow over its limit during an operation; it is trimmed when the outermost operation ends
+    if (!rv.IsEmpty()) {
+        std::unique_ptr<QoreV8KeyString> ks(new QoreV8KeyString);
+        ks->key.assign(key, len);
+        ks->str.Reset(isolate, rv.ToLocalChecked());
+        std::string_view k(ks->key);
+        key_cache.emplace(k, std::move(ks));
+    }
+    return rv;
+}
+
+QoreV8ObjectShape* QoreV8Program::getShape(const QoreHashNode* h) {
+    size_t n = h->size();
+    if (!n || n > max_shape_keys) {
+        return nullptr;
+    }
+
+    // FNV-1a hash of the key sequence
+    size_t sig = 14695981039346656037ULL;
+    ConstHashIterator i(h);
+    while (i.next()) {
+        for (const char* p = i.getKey(); ; ++p) {
+            sig = (sig ^ (unsigned char)*p) * 1099511628211ULL;
+            if (!*p) {
+                break;
+            }
+        }
+    }
+
+    auto si = shape_cache.find(sig);
+    if (si != shape_cache.end()) {
+        QoreV8ObjectShape& shape = si->second;
+        if (shape.names.size() != n) {
+            return nullptr;
+        }
+        size_t idx = 0;
+        ConstHashIterator ki(h);
+        while (ki.next()) {
+            if (shape.names[idx++] != ki.getKey()) {
+                return nullptr;
+            }
+        }
+        return &shape;
+    }
+
+    // a shape is only registered when its key sequence is seen more than once, so one-off hashes do not fill the
+    // cache
+    if (shape_candidates.insert(sig).second) {
+        return nullptr;
+    }
+    shape_candidates.erase(sig);
+
+    v8::Local<v8::ObjectTemplate> tmpl = v8::ObjectTemplate::New(isolate);
+    QoreV8ObjectShape shape;
+    shape.keys.reserve(n);
+    shape.names.reserve(n);
+    ConstHashIterator ki(h);
+    while (ki.next()) {
+        v8::MaybeLocal<v8::String> key = getKeyString(ki.getKey());
+        if (key.IsEmpty()) {
+            return nullptr;
+        }
+        tmpl->Set(key.ToLocalChecked(), v8::Undefined(isolate));
+        shape.keys.emplace_back(isolate, key.ToLocalChecked());
+        shape.names.emplace_back(ki.getKey());
+    }
+    shape.tmpl.Reset(isolate, tmpl);
+    return &shape_cache.emplace(sig, std::move(shape)).first->second;
+}
+
+void QoreV8Program::trimCaches() {
+    // the caches are reset rather than evicted entry by entry; key sequences and keys that recur are cached again
+    // on their next uses
+    if (key_cache.size() > max_key_cache_size) {
+        key_cache.clear();
+    }
+    if (shape_cache.size() > max_shape_cache_size) {
+        shape_cache.clear();
+    }
+    if (shape_candidates.size() > max_shape_candidates) {
+        shape_candidates.clear();
+    }
+}
+
+// returns the program for a container proxy callback
+static QoreV8Program* get_proxy_program(const v8::Local<v8::Value>& data) {
+    return static_cast<QoreV8Program*>(data.As<v8::External>()->Value());
+}
+
+// returns the container for a container proxy callback
+template <typename T>
+static const T* get_proxy_container(const v8::Local<v8::Object>& holder) {
+    return static_cast<const T*>(holder->GetAlignedPointerFromInternalField(0));
+}
+
+// converts a container element for a container proxy callback; nested containers are also returned as proxies
+template <typename T>
+static void return_proxy_value(const v8::PropertyCallbackInfo<T>& info, const QoreValue v) {
+    ExceptionSink xsink;
+    v8::Local<v8::Value> rv = get_proxy_program(info.Data())->getV8Value(v, &xsink);
+    if (xsink) {
+        QoreV8Program::raiseV8Exception(xsink, info.GetIsolate());
+        return;
+    }
+    info.GetReturnValue().Set(rv);
+}
+
+// container proxies are read-only
+template <typename T>
+static void throw_proxy_read_only(const v8::PropertyCallbackInfo<T>& info) {
+    v8::Isolate* isolate = info.GetIsolate();
+    isolate->ThrowException(v8::Exception::TypeError(v8::String::NewFromUtf8Literal(isolate,
+        "Qore hashes and lists cannot be modified in JavaScript")));
+}
+
+static void hash_proxy_getter(v8::Local<v8::Name> name, const v8::PropertyCallbackInfo<v8::Value>& info) {
+    if (!name->IsString()) {
+        return;
+    }
+    v8::String::Utf8Value key(info.GetIsolate(), name);
+    bool exists;
+    QoreValue v = get_proxy_container<QoreHashNode>(info.Holder())->getKeyValueExistence(*key, exists);
+    if (exists) {
+        return_proxy_value(info, v);
+    }
+}
+
+static void hash_proxy_setter(v8::Local<v8::Name> name, v8::Local<v8::Value> value,
+        const v8::PropertyCallbackInfo<v8::Value>& info) {
+    throw_proxy_read_only(info);
+}
+
+static void hash_proxy_query(v8::Local<v8::Name> name, const v8::PropertyCallbackInfo<v8::Integer>& info) {
+    if (!name->IsString()) {
+        return;
+    }
+    v8::String::Utf8Value key(info.GetIsolate(), name);
+    if (get_proxy_container<QoreHashNode>(info.Holder())->existsKey(*key)) {
+        info.GetReturnValue().Set(v8::ReadOnly | v8::DontDelete);
+    }
+}
+
+static void hash_proxy_deleter(v8::Local<v8::Name> name, const v8::PropertyCallbackInfo<v8::Boolean>& info) {
+    throw_proxy_read_only(info);
+}
+
+// returns true if the key is a canonical array index, which V8 passes to indexed property interceptors
+static bool is_array_index_key(const char* key) {
+    if (!*key || (*key == '0' && key[1])) {
+        return false;
+    }
+    uint64_t v = 0;
+    for (const char* p = key; *p; ++p) {
+        if (*p < '0' || *p > '9') {
+            return false;
+        }
+        v = v * 10 + (*p - '0');
+        // 2^32 - 1 is not a valid array index
+        if (v >= 0xffffffffULL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// enumerates either the array-index keys or the other keys of a hash proxy
+static void hash_proxy_enumerate(const v8::PropertyCallbackInfo<v8::Array>& info, bool index_keys) {
+    QoreV8Program* pgm = get_proxy_program(info.Data());
+    const QoreHashNode* h = get_proxy_container<QoreHashNode>(info.Holder());
+    v8::Isolate* isolate = info.GetIsolate();
+    v8::Local<v8::Context> context = isolate->GetCurrentContext();
+    v8::Local<v8::Array> rv = v8::Array::New(isolate, 0);
+    uint32_t idx = 0;
+    ConstHashIterator i(h);
+    while (i.next()) {
+        const char* k = i.getKey();
+        if (is_array_index_key(k) != index_keys) {
+            continue;
+        }
+        v8::MaybeLocal<v8::String> key = pgm->getKeyString(k);
+        if (key.IsEmpty() || rv->Set(context, idx++, key.ToLocalChecked()).IsNothing()) {
+            return;
+        }
+    }
+    info.GetReturnValue().Set(rv);
+}
+
+static void hash_proxy_enumerator(const v8::PropertyCallbackInfo<v8::Array>& info) {
+    hash_proxy_enumerate(info, false);
+}
+
+// array-index keys like "0" or "1" are looked up with their decimal string representation
+static void hash_proxy_indexed_getter(uint32_t index, const v8::PropertyCallbackInfo<v8::Value>& info) {
+    char key[16];
+    snprintf(key, sizeof(key), "%u", index);
+    bool exists;
+    QoreValue v = get_proxy_container<QoreHashNode>(info.Holder())->getKeyValueExistence(key, exists);
+    if (exists) {
+        return_proxy_value(info, v);
+    }
+}
+
+static void hash_proxy_indexed_setter(uint32_t index, v8::Local<v8::Value> value,
+        const v8::PropertyCallbackInfo<v8::Value>& info) {
+    throw_proxy_read_only(info);
+}
+
+static void hash_proxy_indexed_query(uint32_t index, const v8::PropertyCallbackInfo<v8::Integer>& info) {
+    char key[16];
+    snprintf(key, sizeof(key), "%u", index);
+    if (get_proxy_container<QoreHashNode>(info.Holder())->existsKey(key)) {
+        info.GetReturnValue().Set(v8::ReadOnly | v8::DontDelete);
+    }
+}
+
+static void hash_proxy_indexed_deleter(uint32_t index, const v8::PropertyCallbackInfo<v8::Boolean>& info) {
+    throw_proxy_read_only(info);
+}
+
+static void hash_proxy_indexed_enumerator(const v8::PropertyCallbackInfo<v8::Array>& info) {
+    hash_proxy_enumerate(info, true);
+}
+
+static void list_proxy_getter(uint32_t index, const v8::PropertyCallbackInfo<v8::Value>& info) {
+    const QoreListNode* l = get_proxy_container<QoreListNode>(info.Holder());
+    if (index < l->size()) {
+        return_proxy_value(info, l->retrieveEntry(index));
+    }
+}
+
+static void list_proxy_setter(uint32_t index, v8::Local<v8::Value> value,
+        const v8::PropertyCallbackInfo<v8::Value>& info) {
+    throw_proxy_read_only(info);
+}
+
+static void list_proxy_query(uint32_t index, const v8::PropertyCallbackInfo<v8::Integer>& info) {
+    if (index < get_proxy_container<QoreListNode>(info.Holder())->size()) {
+        info.GetReturnValue().Set(v8::ReadOnly | v8::DontDelete);
+    }
+}
+
+static void list_proxy_deleter(uint32_t index, const v8::PropertyCallbackInfo<v8::Boolean>& info) {
+    throw_proxy_read_only(info);
+}
+
+static void list_proxy_enumerator(const v8::PropertyCallbackInfo<v8::Array>& info) {
+    size_t size = get_proxy_container<QoreListNode>(info.Holder())->size();
+    v8::Isolate* isolate = info.GetIsolate();
+    v8::Local<v8::Context> context = isolate->GetCurrentContext();
+    v8::Local<v8::Array> rv = v8::Array::New(isolate, (int)size);
+    for (uint32_t i = 0; i < size; ++i) {
+        if (rv->Set(context, i, v8::Integer::NewFromUnsigned(isolate, i)).IsNothing()) {
+            return;
+        }
+    }
+    info.GetReturnValue().Set(rv);
+}
+
+// list proxies have a read-only "length" property, so Array.prototype methods can be used with them
+static void list_proxy_named_getter(v8::Local<v8::Name> name, const v8::PropertyCallbackInfo<v8::Value>& info) {
+    if (name->IsString() && name.As<v8::String>()->StringEquals(v8::String::NewFromUtf8Literal(info.GetIsolate(),
+        "length"))) {
+        info.GetReturnValue().Set((double)get_proxy_container<QoreListNode>(info.Holder())->size());
+    }
+}
+
+// serializes list proxies as arrays with JSON.stringify()
+static void list_proxy_to_json(const v8::FunctionCallbackInfo<v8::Value>& info) {
+    v8::Local<v8::Value> self = info.This();
+    if (!self->IsObject() || self.As<v8::Object>()->InternalFieldCount() != 1) {
+        return;
+    }
+    QoreV8Program* pgm = get_proxy_program(info.Data());
+    const QoreListNode* l = get_proxy_container<QoreListNode>(self.As<v8::Object>());
+    v8::Isolate* isolate = info.GetIsolate();
+    std::vector<v8::Local<v8::Value>> vec;
+    vec.reserve(l->size());
+    ConstListIterator i(l);
+    while (i.next()) {
+        ExceptionSink xsink;
+        v8::Local<v8::Value> v = pgm->getV8Value(i.getValue(), &xsink);
+        if (xsink) {
+            QoreV8Program::raiseV8Exception(xsink, isolate);
+            return;
+        }
+        vec.push_back(v);
+    }
+    info.GetReturnValue().Set(v8::Array::New(isolate, vec.data(), vec.size()));
+}
+
+v8::Local<v8::FunctionTemplate> QoreV8Program::getContainerProxyTemplate(bool list) {
+    v8::Global<v8::FunctionTemplate>& tmpl = list ? list_proxy_tmpl : hash_proxy_tmpl;
+    if (!tmpl.IsEmpty()) {
+        return tmpl.Get(isolate);
+    }
+
+    v8::Local<v8::External> data = v8::External::New(isolate, (void*)this);
+    v8::Local<v8::FunctionTemplate> ft = v8::FunctionTemplate::New(isolate);
+    v8::Local<v8::ObjectTemplate> it = ft->InstanceTemplate();
+    // the internal field holds the container, which is kept valid with a saved reference
+    it->SetInternalFieldCount(1);
+    if (list) {
+        it->SetHandler(v8::IndexedPropertyHandlerConfiguration(list_proxy_getter, list_proxy_setter,
+            list_proxy_query, list_proxy_deleter, list_proxy_enumerator, data));
+        it->SetHandler(v8::NamedPropertyHandlerConfiguration(list_proxy_named_getter, nullptr, nullptr, nullptr,
+            nullptr, data, v8::PropertyHandlerFlags::kOnlyInterceptStrings));
+        ft->PrototypeTemplate()->Set(v8::String::NewFromUtf8Literal(isolate, "toJSON"),
+            v8::FunctionTemplate::New(isolate, list_proxy_to_json, data), v8::DontEnum);
+    } else {
+        it->SetHandler(v8::NamedPropertyHandlerConfiguration(hash_proxy_getter, hash_proxy_setter,
+            hash_proxy_query, hash_proxy_deleter, hash_proxy_enumerator, data,
+            v8::PropertyHandlerFlags::kOnlyInterceptStrings));
+        it->SetHandler(v8::IndexedPropertyHandlerConfiguration(hash_proxy_indexed_getter,
+            hash_proxy_indexed_setter, hash_proxy_indexed_query, hash_proxy_indexed_deleter,
+            hash_proxy_indexed_enumerator, data));
+    }
+    tmpl.Reset(isolate, ft);
+    return ft;
+}
+
+v8::MaybeLocal<v8::Object> QoreV8Program::getContainerProxy(ExceptionSink* xsink, const QoreValue val,
+        const v8::TryCatch& tryCatch) {
+    bool list = val.getType() == NT_LIST;
+    bool init = (list ? list_proxy_tmpl : hash_proxy_tmpl).IsEmpty();
+    v8::Local<v8::Context> context = setup->context();
+    v8::MaybeLocal<v8::Function> f = getContainerProxyTemplate(list)->GetFunction(context);
+    if (f.IsEmpty()) {
+        checkException(xsink, tryCatch);
+        return v8::MaybeLocal<v8::Object>();
+    }
+    v8::Local<v8::Function> func = f.ToLocalChecked();
+    if (list && init) {
+        // list proxies inherit from Array.prototype
+        v8::MaybeLocal<v8::Value> proto = func->Get(context, v8::String::NewFromUtf8Literal(isolate, "prototype"));
+        if (proto.IsEmpty() || proto.ToLocalChecked().As<v8::Object>()->SetPrototype(context,
+            v8::Array::New(isolate)->GetPrototype()).IsNothing()) {
+            checkException(xsink, tryCatch);
+            return v8::MaybeLocal<v8::Object>();
+        }
+    }
+    v8::MaybeLocal<v8::Object> rv = func->NewInstance(context);
+    if (rv.IsEmpty()) {
+        checkException(xsink, tryCatch);
+        return v8::MaybeLocal<v8::Object>();
+    }
+    v8::Local<v8::Object> obj = rv.ToLocalChecked();
+    obj->SetAlignedPointerInInternalField(0, const_cast<AbstractQoreNode*>(val.getInternalNode()));
+    // the container is referenced until the proxy is collected
+    holdQoreReference(val, obj);
+    return rv;
+}
+
+QoreValue QoreV8Program::getProxiedContainer(v8::Local<v8::Object> obj) const {
+    if (obj->InternalFieldCount() != 1) {
+        return QoreValue();
+    }
+    if (!qore_object_tmpl.IsEmpty() && qore_object_tmpl.Get(isolate)->HasInstance(obj)) {
+        return static_cast<QoreObject*>(obj->GetAlignedPointerFromInternalField(0));
+    }
+    if (!hash_proxy_tmpl.IsEmpty() && hash_proxy_tmpl.Get(isolate)->HasInstance(obj)) {
+        return get_proxy_container<QoreHashNode>(obj);
+    }
+    if (!list_proxy_tmpl.IsEmpty() && list_proxy_tmpl.Get(isolate)->HasInstance(obj)) {
+        return get_proxy_container<QoreListNode>(obj);
+    }
+    return QoreValue();
+}
+
+static constexpr size_t max_class_method_cache_size = 1024;
+
+// calls a Qore method on the Qore object wrapped by "this"
+static void qore_object_method_call(const v8::FunctionCallbackInfo<v8::Value>& info) {
+    QoreV8ClassMethod* m = static_cast<QoreV8ClassMethod*>(info.Data().As<v8::External>()->Value());
+    QoreV8Program* pgm = m->cls_info->pgm;
+    v8::Isolate* isolate = info.GetIsolate();
+
+    ExceptionSink xsink;
+    ValueHolder self(info.This()->IsObject() ? pgm->getProxiedValue(info.This().As<v8::Object>()) : QoreValue(),
+        &xsink);
+    if (self->getType() != NT_OBJECT) {
+        xsink.raiseException("JAVASCRIPT-TYPE-ERROR", "Qore method '%s::%s()' called on an object that is not a "
+            "Qore object", m->cls_info->cls->getName(), m->name.c_str());
+        QoreV8Program::raiseV8Exception(xsink, isolate);
+        return;
+    }
+
+    ReferenceHolder<QoreListNode> args(&xsink);
+    int len = info.Length();
+    if (len) {
+        args = new QoreListNode(autoTypeInfo);
+        for (int i = 0; i < len; ++i) {
+            ValueHolder arg(pgm->getQoreValue(&xsink, info[i]), &xsink);
+            if (xsink) {
+                QoreV8Program::raiseV8Exception(xsink, isolate);
+                return;
+            }
+            args->push(arg.release(), &xsink);
+        }
+    }
+
+    ValueHolder rv(self->get<QoreObject>()->evalMethod(m->name.c_str(), *args, &xsink), &xsink);
+    if (xsink) {
+        QoreV8Program::raiseV8Exception(xsink, isolate);
+        return;
+    }
+    v8::Local<v8::Value> v8rv = pgm->getV8Value(*rv, &xsink);
+    if (xsink) {
+        QoreV8Program::raiseV8Exception(xsink, isolate);
+        return;
+    }
+    info.GetReturnValue().Set(v8rv);
+}
+
+// returns the method function for the given property of a Qore object wrapper; the result of the lookup is cached
+// for the class, so each later access only costs the interceptor call and a hash lookup
+static void qore_object_getter(v8::Local<v8::Name> name, const v8::PropertyCallbackInfo<v8::Value>& info) {
+    QoreV8ClassInfo* ci = static_cast<QoreV8ClassInfo*>(info.Data().As<v8::External>()->Value());
+    v8::Isolate* isolate = info.GetIsolate();
+    v8::String::Utf8Value str(isolate, name);
+    std::string key(*str, str.length());
+
+    auto i = ci->methods.find(key);
+    if (i == ci->methods.end()) {
+        // only public methods are exposed; private and internal methods are treated like missing methods
+        ClassAccess access;
+        bool is_method = ci->cls->findMethod(key.c_str(), access) && access == Public;
+        if (!is_method && ci->methods.size() >= max_class_method_cache_size) {
+            return;
+        }
+        i = ci->methods.emplace(key, QoreV8ClassMethod()).first;
+        QoreV8ClassMethod& m = i->second;
+        m.cls_info = ci;
+        m.name = std::move(key);
+        if (is_method) {
+            v8::MaybeLocal<v8::Function> f = v8::Function::New(isolate->GetCurrentContext(),
+                qore_object_method_call, v8::External::New(isolate, (void*)&m));
+            if (f.IsEmpty()) {
+                ci->methods.erase(i);
+                return;
+            }
+            m.func.Reset(isolate, f.ToLocalChecked());
+        }
+    }
+    if (!i->second.func.IsEmpty()) {
+        info.GetReturnValue().Set(i->second.func.Get(isolate));
+    }
+}
+
+v8::MaybeLocal<v8::Object> QoreV8Program::getObjectWrapper(ExceptionSink* xsink, QoreObject* obj,
+        const v8::TryCatch& tryCatch) {
+    const QoreClass* cls = obj->getClass();
+    auto i = class_cache.find(cls->getID());
+    if (i == class_cache.end()) {
+        if (qore_object_tmpl.IsEmpty()) {
+            qore_object_tmpl.Reset(isolate, v8::FunctionTemplate::New(isolate));
+        }
+        std::unique_ptr<QoreV8ClassInfo> ci(new QoreV8ClassInfo(this, cls));
+        v8::Local<v8::FunctionTemplate> ft = v8::FunctionTemplate::New(isolate);
+        v8::MaybeLocal<v8::String> name = getKeyString(cls->getName());
+        if (name.IsEmpty()) {
+            checkException(xsink, tryCatch);
+            return v8::MaybeLocal<v8::Object>();
+        }
+        ft->SetClassName(name.ToLocalChecked());
+        ft->Inherit(qore_object_tmpl.Get(isolate));
+        v8::Local<v8::ObjectTemplate> it = ft->InstanceTemplate();
+        // the internal field holds the object, which is kept valid with a saved reference
+        it->SetInternalFieldCount(1);
+        it->SetHandler(v8::NamedPropertyHandlerConfiguration(qore_object_getter, nullptr, nullptr, nullptr, nullptr,
+            v8::External::New(isolate, (void*)ci.get()), v8::PropertyHandlerFlags::kOnlyInterceptStrings));
+        ci->tmpl.Reset(isolate, ft);
+        i = class_cache.emplace(cls->getID(), std::move(ci)).first;
+    }
+
+    v8::Local<v8::Context> context = setup->context();
+    v8::MaybeLocal<v8::Function> f = i->second->tmpl.Get(isolate)->GetFunction(context);
+    if (f.IsEmpty()) {
+        checkException(xsink, tryCatch);
+        return v8::MaybeLocal<v8::Object>();
+    }
+    v8::MaybeLocal<v8::Object> rv = f.ToLocalChecked()->NewInstance(context);
+    if (rv.IsEmpty()) {
+        checkException(xsink, tryCatch);
+        return v8::MaybeLocal<v8::Object>();
+    }
+    v8::Local<v8::Object> wrapper = rv.ToLocalChecked();
+    wrapper->SetAlignedPointerInInternalField(0, obj);
+    // the object is referenced until the wrapper is collected
+    holdQoreReference(obj, wrapper);
+    return rv;
+}
+
+// conversion options
+static const struct {
+    const char* name;
+    int flag;
+} conversion_options[] = {
+    {"typed_arrays", QV8_CO_TYPED_ARRAYS},
+    {"typed_array_binary", QV8_CO_TYPED_ARRAY_BINARY},
+    {"lazy_containers", QV8_CO_LAZY_CONTAINERS},
+};
+
+int QoreV8Program::setConversionOptions(ExceptionSink* xsink, const QoreHashNode* opts) {
+    int flags = conv_opts.load();
+    ConstHashIterator i(opts);
+    while (i.next()) {
+        int flag = 0;
+        for (const auto& opt : conversion_options) {
+            if (!strcmp(opt.name, i.getKey())) {
+                flag = opt.flag;
+                break;
+            }
+        }
+        if (!flag) {
+            xsink->raiseException("JAVASCRIPT-OPTION-ERROR", "unknown conversion option '%s'", i.getKey());
+            return -1;
+        }
+        if (i.get().getAsBool()) {
+            flags |= flag;
+        } else {
+            flags &= ~flag;
+        }
+    }
+    conv_opts = flags;
+    return 0;
+}
+
+QoreHashNode* QoreV8Program::getConversionOptions() const {
+    ReferenceHolder<QoreHashNode> rv(new QoreHashNode(boolTypeInfo), nullptr);
+    int flags = conv_opts.load();
+    for (const auto& opt : conversion_options) {
+        rv->setKeyValue(opt.name, (bool)(flags & opt.flag), nullptr);
+    }
+    return rv.release();
+}
+
+QoreStringNode* QoreV8Program::getQoreString(v8::Isolate* isolate, v8::Local<v8::String> str) {
+    SimpleRefHolder<QoreStringNode> rv(new QoreStringNode(QCS_UTF8));
+    int len = str->Length();
+    if (!len) {
+        return rv.release();
+    }
+    // the string is written directly into the buffer of the Qore string
+    size_t utf8_len = str->Utf8Length(isolate);
+    rv->reserve(utf8_len + 1);
+    char* buf = rv->getBuffer();
+    if (utf8_len == (size_t)len) {
+        // ASCII data is copied without transcoding
+        str->WriteOneByte(isolate, reinterpret_cast<uint8_t*>(buf), 0, len, v8::String::NO_NULL_TERMINATION);
+    } else {
+        str->WriteUtf8(isolate, buf, (int)utf8_len, nullptr,
+            v8::String::NO_NULL_TERMINATION | v8::String::REPLACE_INVALID_UTF8);
+    }
+    rv->terminate(utf8_len);
+    return rv.release();
+}
+
 QoreValue QoreV8Program::getQoreValue(ExceptionSink* xsink, v8::Local<v8::Value> val) {
     v8::Local<v8::Context> context = setup->context(); //this->context.Get(isolate);
 
@@ -352,8 +1507,7 @@ QoreValue QoreV8Program::getQoreValue(ExceptionSink* xsink, v8::Local<v8::Value>
     }
 
     if (val->IsString()) {
-        v8::String::Utf8Value str(isolate, val);
-        return new QoreStringNode(*str, QCS_UTF8);
+        return getQoreString(isolate, val.As<v8::String>());
     }
 
     if (val->IsNumber()) {
@@ -369,20 +1523,45 @@ QoreValue QoreV8Program::getQoreValue(ExceptionSink* xsink, v8::Local<v8::Value>
     }
 
     if (val->IsArray()) {
-        v8::Local<v8::Array> array = v8::Local<v8::Array>::Cast(val);
         ReferenceHolder<QoreListNode> rv(new QoreListNode(autoTypeInfo), xsink);
-        for (uint32_t i = 0, e = array->Length(); i < e; ++i) {
-            v8::MaybeLocal<v8::Value> val = array->Get(context, i);
-            if (val.IsEmpty()) {
-                rv->push(QoreValue(), xsink);
-                continue;
-            }
-            v8::Local<v8::Value> v = val.ToLocalChecked();
-            ValueHolder qv(getQoreValue(xsink, v), xsink);
-            if (*xsink) {
-                return QoreValue();
+        if (getList(xsink, isolate, context, val.As<v8::Array>(), *rv, [this, xsink] (v8::Local<v8::Value> v) {
+            return getQoreValue(xsink, v);
+        })) {
+            if (!*xsink) {
+                checkException(xsink, tryCatch);
             }
-            rv->push(qv.release(), xsink);
+            return QoreValue();
+        }
+        return rv.release();
+    }
+
+    if (val->IsMap()) {
+        ReferenceHolder<QoreHashNode> rv(new QoreHashNode(autoTypeInfo), xsink);
+        int rc = getHash(xsink, isolate, context, val.As<v8::Map>(), *rv, [this, xsink] (v8::Local<v8::Value> v) {
+            return getQoreValue(xsink, v);
+        });
+        if (rc < 0) {
+            if (!*xsink) {
+                checkException(xsink, tryCatch);
+            }
+            return QoreValue();
+        }
+        // Maps with other keys are returned as JavaScriptObject objects
+        if (!rc) {
+            return rv.release();
+        }
+    }
+
+    if (val->IsSet()) {
+        ReferenceHolder<QoreListNode> rv(new QoreListNode(autoTypeInfo), xsink);
+        if (getList(xsink, isolate, context, val.As<v8::Set>()->AsArray(), *rv, [this, xsink]
+            (v8::Local<v8::Value> v) {
+                return getQoreValue(xsink, v);
+            })) {
+            if (!*xsink) {
+                checkException(xsink, tryCatch);
+            }
+            return QoreValue();
         }
         return rv.release();
     }
@@ -396,7 +1575,68 @@ QoreValue QoreV8Program::getQoreValue(ExceptionSink* xsink, v8::Local<v8::Value>
         return new QoreObject(QC_JAVASCRIPTPROMISE, getProgram(), pd.release());
     }
 
+    if (val->IsDate()) {
+        double ms = val.As<v8::Date>()->ValueOf();
+        // invalid dates are converted like null
+        if (std::isnan(ms)) {
+            return QoreValue();
+        }
+        int64 t = (int64)ms;
+        int64 secs = t / 1000;
+        int64 rem = t % 1000;
+        if (rem < 0) {
+            --secs;
+            rem += 1000;
+        }
+        return DateTimeNode::makeAbsolute(currentTZ(), secs, (int)(rem * 1000));
+    }
+
+    if (val->IsArrayBufferView()) {
+        // numeric typed arrays are converted to lists unless binary conversion has been requested
+        if (val->IsTypedArray() && !(conv_opts & QV8_CO_TYPED_ARRAY_BINARY)) {
+            QoreListNode* l = get_typed_array_list(val.As<v8::TypedArray>());
+            if (l) {
+                return l;
+            }
+        }
+        // Uint8Array, DataView, and Node.js Buffer objects
+        v8::Local<v8::ArrayBufferView> view = val.As<v8::ArrayBufferView>();
+        size_t len = view->ByteLength();
+        if (!len) {
+            return new BinaryNode;
+        }
+        void* p = malloc(len);
+        if (!p) {
+            xsink->outOfMemory();
+            return QoreValue();
+        }
+        view->CopyContents(p, len);
+        return new BinaryNode(p, len);
+    }
+
+    if (val->IsArrayBuffer() || val->IsSharedArrayBuffer()) {
+        std::shared_ptr<v8::BackingStore> bs = val->IsArrayBuffer()
+            ? val.As<v8::ArrayBuffer>()->GetBackingStore()
+            : val.As<v8::SharedArrayBuffer>()->GetBackingStore();
+        size_t len = bs->ByteLength();
+        if (!len) {
+            return new BinaryNode;
+        }
+        void* p = malloc(len);
+        if (!p) {
+            xsink->outOfMemory();
+            return QoreValue();
+        }
+        memcpy(p, bs->Data(), len);
+        return new BinaryNode(p, len);
+    }
+
     if (val->IsObject()) {
+        // container proxies are returned as the original hash or list
+        QoreValue c = getProxiedValue(val.As<v8::Object>());
+        if (c) {
+            return c;
+        }
         v8::MaybeLocal<v8::Object> o = val->ToObject(context);
         if (o.IsEmpty()) {
             checkException(xsink, tryCatch);
@@ -417,6 +1657,13 @@ QoreValue QoreV8Program::getQoreValue(ExceptionSink* xsink, v8::Local<v8::Value>
 }
 
 void QoreV8Program::raiseV8Exception(ExceptionSink& xsink, v8::Isolate* isolate) {
+    v8::Local<v8::Value> ex = getV8ExceptionValue(xsink, isolate);
+    if (!ex.IsEmpty()) {
+        isolate->ThrowException(ex);
+    }
+}
+
+v8::Local<v8::Value> QoreV8Program::getV8ExceptionValue(ExceptionSink& xsink, v8::Isolate* isolate) {
     assert(xsink);
     QoreString err;
     QoreString desc;
@@ -446,13 +1693,16 @@ void QoreV8Program::raiseV8Exception(ExceptionSink& xsink, v8::Isolate* isolate)
     QoreStringMaker str("%s: %s", errstr->c_str(), descstr->c_str());
 
     v8::MaybeLocal<v8::String> exstr = v8::String::NewFromUtf8(isolate, str.c_str(), v8::NewStringType::kNormal);
-    if (!exstr.IsEmpty()) {
-        isolate->ThrowException(exstr.ToLocalChecked());
-    }
     xsink.clear();
+    return exstr.IsEmpty() ? v8::Local<v8::Value>() : v8::Local<v8::Value>(exstr.ToLocalChecked());
 }
 
 int QoreV8Program::spinOnce() {
+    // the loop is driven by the event loop thread
+    QoreV8EventLoop* el = getEventLoopThread();
+    if (el && !el->inLoopThread()) {
+        return 0;
+    }
     uv_loop_t* loop = setup->event_loop();
 
     v8::Locker locker(isolate);
@@ -464,25 +1714,15 @@ int QoreV8Program::spinOnce() {
 }
 
 int QoreV8Program::spinEventLoop() {
+    QoreV8EventLoop* el = getEventLoopThread();
+    if (el && !el->inLoopThread()) {
+        return 0;
+    }
     v8::Locker locker(isolate);
     v8::Isolate::Scope isolate_scope(isolate);
     return node::SpinEventLoop(env).FromMaybe(1);
 }
 
-struct QoreV8CallbackInfo {
-    ResolvedCallReferenceNode* ref;
-    QoreV8Program* pgm;
-
-    DLLLOCAL QoreV8CallbackInfo(const ResolvedCallReferenceNode* ref, QoreV8Program* pgm)
-            : ref(const_cast<ResolvedCallReferenceNode*>(ref)), pgm(pgm) {
-        this->ref->weakRef();
-    }
-
-    DLLLOCAL ~QoreV8CallbackInfo() {
-        ref->weakDeref();
-    }
-};
-
 static void call_callref(const v8::FunctionCallbackInfo<v8::Value>& info) {
     v8::Local<v8::Value> v = info.Data();
     assert(v->IsExternal());
@@ -535,10 +1775,60 @@ static void call_callref(const v8::FunctionCallbackInfo<v8::Value>& info) {
     info.GetReturnValue().Set(v8rv);
 }
 
-static void deref_callref(const v8::WeakCallbackInfo<QoreV8CallbackInfo>& data) {
-    delete data.GetParameter();
+static void call_async_callref(const v8::FunctionCallbackInfo<v8::Value>& info) {
+    v8::Local<v8::Value> v = info.Data();
+    assert(v->IsExternal());
+
+    v8::Local<v8::External> ext = v8::Local<v8::External>::Cast(v);
+    QoreV8CallbackInfo* cbinfo = reinterpret_cast<QoreV8CallbackInfo*>(ext->Value());
+
+    v8::Isolate* isolate = info.GetIsolate();
+
+    ExceptionSink xsink;
+    OptionalCallReferenceAccessHelper rh(&xsink, cbinfo->ref);
+    if (!rh) {
+        assert(xsink);
+        // raise JS exception
+        QoreV8Program::raiseV8Exception(xsink, isolate);
+        return;
+    }
+
+    // arguments are converted in the JavaScript thread
+    ReferenceHolder<QoreListNode> args(&xsink);
+    int len = info.Length();
+    if (len) {
+        args = new QoreListNode(autoTypeInfo);
+        for (int i = 0; i < len; ++i) {
+            ValueHolder arg(cbinfo->pgm->getQoreValue(&xsink, info[i]), &xsink);
+            if (xsink) {
+                // raise JS exception
+                QoreV8Program::raiseV8Exception(xsink, isolate);
+                return;
+            }
+            args->push(arg.release(), &xsink);
+            assert(!xsink);
+        }
+    }
+
+    v8::MaybeLocal<v8::Promise::Resolver> resolver = v8::Promise::Resolver::New(isolate->GetCurrentContext());
+    if (resolver.IsEmpty()) {
+        // a JavaScript exception has been thrown
+        return;
+    }
+    v8::Local<v8::Promise::Resolver> r = resolver.ToLocalChecked();
+    if (cbinfo->pgm->startAsyncCall(&xsink, cbinfo->ref->refRefSelf(), args.release(), r)) {
+        QoreV8Program::raiseV8Exception(xsink, isolate);
+        return;
+    }
+    info.GetReturnValue().Set(r->GetPromise());
 }
 
+static void deref_callref(const v8::WeakCallbackInfo<QoreV8CallbackInfo>& data) {
+    QoreV8CallbackInfo* cbinfo = data.GetParameter();
+    cbinfo->func.Reset();
+    cbinfo->pgm->removeCallbackInfo(cbinfo);
+    delete cbinfo;
+}
 v8::Local<v8::Value> QoreV8Program::getV8Value(const QoreValue val, ExceptionSink* xsink) {
     //printd(5, "QoreV8Program::getV8Value() type '%s'\n", val.getFullTypeName());
 
@@ -565,8 +1855,20 @@ v8::Local<v8::Value> QoreV8Program::getV8Value(const QoreValue val, ExceptionSin
         }
 
         case NT_STRING: {
-            v8::MaybeLocal<v8::String> rv = v8::String::NewFromUtf8(isolate, val.get<const QoreStringNode>()->c_str(),
-                v8::NewStringType::kNormal);
+            const QoreStringNode* str = val.get<const QoreStringNode>();
+            if (str->size() > (size_t)v8::String::kMaxLength) {
+                xsink->raiseException("JAVASCRIPT-TYPE-ERROR", "Cannot convert a string of " QLLD " bytes to a V8 "
+                    "string; the maximum length is %d", (int64)str->size(), v8::String::kMaxLength);
+                return v8::Null(isolate);
+            }
+            v8::MaybeLocal<v8::String> rv;
+            // large ASCII strings are shared with JavaScript without copying
+            if (str->size() >= QV8_EXTERNAL_STRING_MIN && str->getEncoding()->isAsciiCompat()
+                && str->isDataAscii()) {
+                rv = v8::String::NewExternalOneByte(isolate, new QoreV8ExternalString(str));
+            } else {
+                rv = v8::String::NewFromUtf8(isolate, str->c_str(), v8::NewStringType::kNormal, (int)str->size());
+            }
             if (rv.IsEmpty()) {
                 checkException(xsink, tryCatch);
                 return v8::Null(isolate);
@@ -575,9 +1877,19 @@ v8::Local<v8::Value> QoreV8Program::getV8Value(const QoreValue val, ExceptionSin
         }
 
         case NT_DATE: {
-            // format the date as an ISO-8601 string
+            const DateTimeNode* d = val.get<const DateTimeNode>();
+            if (d->isAbsolute()) {
+                v8::MaybeLocal<v8::Value> rv = v8::Date::New(setup->context(),
+                    (double)d->getEpochMillisecondsUTC());
+                if (rv.IsEmpty()) {
+                    checkException(xsink, tryCatch);
+                    return v8::Null(isolate);
+                }
+                return handle_scope.Escape(rv.ToLocalChecked());
+            }
+            // format relative dates as ISO-8601 duration strings
             QoreString str;
-            val.get<const DateTimeNode>()->format(str, "IF");
+            d->format(str, "IF");
             v8::MaybeLocal<v8::String> rv = v8::String::NewFromUtf8(isolate, str.c_str(), v8::NewStringType::kNormal);
             if (rv.IsEmpty()) {
                 checkException(xsink, tryCatch);
@@ -599,17 +1911,31 @@ v8::Local<v8::Value> QoreV8Program::getV8Value(const QoreValue val, ExceptionSin
         }
 
         case NT_BINARY: {
-            QoreString str(val.get<const BinaryNode>());
-            v8::MaybeLocal<v8::String> rv = v8::String::NewFromUtf8(isolate, str.c_str(), v8::NewStringType::kNormal);
-            if (rv.IsEmpty()) {
-                checkException(xsink, tryCatch);
-                return v8::Null(isolate);
+            const BinaryNode* b = val.get<const BinaryNode>();
+            // binary values are immutable and may be shared, also through the containers that hold them, but
+            // JavaScript can write to an ArrayBuffer, so the data is always copied
+            v8::Local<v8::ArrayBuffer> ab = v8::ArrayBuffer::New(isolate, b->size());
+            if (b->size()) {
+                memcpy(ab->GetBackingStore()->Data(), b->getPtr(), b->size());
             }
-            return handle_scope.Escape(rv.ToLocalChecked());
+            return handle_scope.Escape(ab);
         }
 
         case NT_LIST: {
             const QoreListNode* l = val.get<const QoreListNode>();
+            if (!l->empty() && (conv_opts & QV8_CO_TYPED_ARRAYS)) {
+                v8::Local<v8::Value> rv = get_typed_array(isolate, l);
+                if (!rv.IsEmpty()) {
+                    return handle_scope.Escape(rv);
+                }
+            }
+            if (conv_opts & QV8_CO_LAZY_CONTAINERS) {
+                v8::MaybeLocal<v8::Object> rv = getContainerProxy(xsink, val, tryCatch);
+                if (rv.IsEmpty()) {
+                    return v8::Null(isolate);
+                }
+                return handle_scope.Escape(rv.ToLocalChecked());
+            }
             std::vector<v8::Local<v8::Value>> vec;
             vec.reserve(l->size());
             ConstListIterator i(l);
@@ -625,17 +1951,39 @@ v8::Local<v8::Value> QoreV8Program::getV8Value(const QoreValue val, ExceptionSin
         }
 
         case NT_HASH: {
+            if (conv_opts & QV8_CO_LAZY_CONTAINERS) {
+                v8::MaybeLocal<v8::Object> rv = getContainerProxy(xsink, val, tryCatch);
+                if (rv.IsEmpty()) {
+                    return v8::Null(isolate);
+                }
+                return handle_scope.Escape(rv.ToLocalChecked());
+            }
             const QoreHashNode* h = val.get<const QoreHashNode>();
             v8::Local<v8::Context> context = setup->context(); //this->context.Get(isolate);
-            v8::Local<v8::Object> obj = v8::Object::New(isolate);
+            // objects for hashes with the same keys are created from a template, so they share a hidden class
+            // without repeating map transitions
+            QoreV8ObjectShape* shape = getShape(h);
+            v8::Local<v8::Object> obj;
+            if (shape) {
+                v8::MaybeLocal<v8::Object> o = shape->tmpl.Get(isolate)->NewInstance(context);
+                if (o.IsEmpty()) {
+                    checkException(xsink, tryCatch);
+                    return v8::Null(isolate);
+                }
+                obj = o.ToLocalChecked();
+            } else {
+                obj = v8::Object::New(isolate);
+            }
+            size_t idx = 0;
             ConstHashIterator i(h);
             while (i.next()) {
                 v8::Local<v8::Value> v = getV8Value(i.get(), xsink);
                 if (*xsink) {
                     return v8::Null(isolate);
                 }
-                v8::MaybeLocal<v8::String> key = v8::String::NewFromUtf8(isolate, i.getKey(),
-                    v8::NewStringType::kNormal);
+                v8::MaybeLocal<v8::String> key = shape
+                    ? v8::MaybeLocal<v8::String>(shape->keys[idx++].Get(isolate))
+                    : getKeyString(i.getKey());
                 if (key.IsEmpty()) {
                     checkException(xsink, tryCatch);
                     return v8::Null(isolate);
@@ -658,9 +2006,12 @@ v8::Local<v8::Value> QoreV8Program::getV8Value(const QoreValue val, ExceptionSin
                 return v8::Null(isolate);
             }
             if (!pd) {
-                xsink->raiseException("JAVASCRIPT-TYPE-ERROR", "Cannot convert Qore values of type '%s' to a V8 "
-                    "value", val.getFullTypeName());
-                return v8::Null(isolate);
+                // other objects are wrapped, and their methods can be called from JavaScript
+                v8::MaybeLocal<v8::Object> rv = getObjectWrapper(xsink, obj, tryCatch);
+                if (rv.IsEmpty()) {
+                    return v8::Null(isolate);
+                }
+                return handle_scope.Escape(rv.ToLocalChecked());
             }
             return handle_scope.Escape(pd->get(xsink, isolate));
         }
@@ -685,29 +2036,438 @@ v8::Local<v8::Value> QoreV8Program::getV8Value(const QoreValue val, ExceptionSin
 }
 
 v8::MaybeLocal<v8::Function> QoreV8Program::getV8Function(ExceptionSink* xsink, const ResolvedCallReferenceNode* call,
-        const v8::TryCatch& tryCatch, v8::EscapableHandleScope& handle_scope) {
-    QoreV8CallbackInfo* cbinfo = new QoreV8CallbackInfo(call, this);
-    v8::Local<v8::External> ext = v8::External::New(isolate, (void*)cbinfo);
+        const v8::TryCatch& tryCatch, v8::EscapableHandleScope& handle_scope, bool async) {
+    // return the existing function for the call reference, if any
+    callback_map_t& cache = async ? async_callback_cache : callback_cache;
+    callback_map_t::iterator i = cache.find(call);
+    if (i != cache.end()) {
+        v8::Local<v8::Function> func = i->second->func.Get(isolate);
+        if (!func.IsEmpty()) {
+            return v8::MaybeLocal<v8::Function>(handle_scope.Escape(func));
+        }
+    }
 
-    // add callback to external object
-    v8::Global<v8::External> gext;
-    gext.Reset(isolate, ext);
-    gext.SetWeak(cbinfo, deref_callref, v8::WeakCallbackType::kParameter);
+    std::unique_ptr<QoreV8CallbackInfo> cbinfo(new QoreV8CallbackInfo(call, this, async));
+    v8::Local<v8::External> ext = v8::External::New(isolate, (void*)cbinfo.get());
 
     v8::Local<v8::Context> context = setup->context();
-    v8::MaybeLocal<v8::Function> func = v8::Function::New(context, call_callref, ext);
+    v8::MaybeLocal<v8::Function> func = v8::Function::New(context, async ? call_async_callref : call_callref, ext);
     if (func.IsEmpty()) {
         //printd(5, "call: %p -> func empty\n", call);
         checkException(xsink, tryCatch);
         return v8::MaybeLocal<v8::Function>();
     }
-    if (saveQoreReference(call->refSelf(), *xsink)) {
+    v8::Local<v8::Function> f = func.ToLocalChecked();
+    if (saveQoreReference(const_cast<ResolvedCallReferenceNode*>(call), f, *xsink)) {
         //printd(5, "call: %p -> cannot save Qore reference\n", call);
         assert(*xsink);
         return v8::MaybeLocal<v8::Function>();
     }
+
+    // the callback info is deleted when the function is collected
+    cbinfo->func.Reset(isolate, f);
+    cbinfo->func.SetWeak(cbinfo.get(), deref_callref, v8::WeakCallbackType::kParameter);
+    if (i != cache.end()) {
+        // the previous info is deleted by its weak callback
+        i->second = cbinfo.release();
+    } else {
+        cache.insert(callback_map_t::value_type(call, cbinfo.release()));
+    }
     //printd(5, "call: %p -> returning JS function object\n", call);
-    return v8::MaybeLocal<v8::Function>(handle_scope.Escape(func.ToLocalChecked()));
+    return v8::MaybeLocal<v8::Function>(handle_scope.Escape(f));
+}
+
+void QoreV8Program::removeCallbackInfo(QoreV8CallbackInfo* cbinfo) {
+    callback_map_t& cache = cbinfo->async ? async_callback_cache : callback_cache;
+    callback_map_t::iterator i = cache.find(cbinfo->ref);
+    if (i != cache.end() && i->second == cbinfo) {
+        cache.erase(i);
+    }
+}
+
+void QoreV8Program::clearCallbackCache(callback_map_t& cache) {
+    for (auto& i : cache) {
+        i.second->func.Reset();
+        delete i.second;
+    }
+    cache.clear();
+}
+
+static int get_func_type(ExceptionSink* xsink, const char* type, qv8_func_type_e& t) {
+    if (!strcmp(type, "auto")) {
+        t = QV8_FT_AUTO;
+    } else if (!strcmp(type, "int")) {
+        t = QV8_FT_INT;
+    } else if (!strcmp(type, "float")) {
+        t = QV8_FT_FLOAT;
+    } else if (!strcmp(type, "bool")) {
+        t = QV8_FT_BOOL;
+    } else if (!strcmp(type, "string")) {
+        t = QV8_FT_STRING;
+    } else {
+        xsink->raiseException("JAVASCRIPT-FUNCTION-ERROR", "unsupported type '%s'; expecting one of 'int', "
+            "'float', 'bool', 'string', or 'auto'", type);
+        return -1;
+    }
+    return 0;
+}
+
+// converts a BigInt of any size to the nearest double; values out of the double range return an infinite value
+static double bigint_to_double(v8::Local<v8::BigInt> b) {
+    bool lossless;
+    int64 i64 = b->Int64Value(&lossless);
+    if (lossless) {
+        return (double)i64;
+    }
+    int sign;
+    int count = b->WordCount();
+    std::vector<uint64_t> words(count);
+    b->ToWordsArray(&sign, &count, words.data());
+    double rv = 0;
+    for (int i = count - 1; i >= 0; --i) {
+        rv = rv * 18446744073709551616.0 + (double)words[i];
+    }
+    return sign ? -rv : rv;
+}
+
+// converts a typed function argument; returns 0 for OK, -1 if a JavaScript exception has been thrown
+static int get_typed_arg(QoreV8TypedFunction* tf, v8::Isolate* isolate, v8::Local<v8::Value> v, unsigned i,
+        QoreValue& rv) {
+    switch (tf->arg_types[i]) {
+        case QV8_FT_INT:
+            if (v->IsInt32()) {
+                rv = (int64)v.As<v8::Int32>()->Value();
+                return 0;
+            }
+            if (v->IsNumber()) {
+                // NaN, infinite, and out of range values cannot be converted to an integer
+                double d = v.As<v8::Number>()->Value();
+                if (std::isfinite(d) && d >= -9223372036854775808.0 && d < 9223372036854775808.0) {
+                    rv = (int64)d;
+                    return 0;
+                }
+                break;
+            }
+            if (v->IsBigInt()) {
+                // BigInts out of the int range cannot be converted without truncation
+                bool lossless;
+                int64 i64 = v.As<v8::BigInt>()->Int64Value(&lossless);
+                if (lossless) {
+                    rv = i64;
+                    return 0;
+                }
+            }
+            break;
+
+        case QV8_FT_FLOAT:
+            if (v->IsNumber()) {
+                rv = v.As<v8::Number>()->Value();
+                return 0;
+            }
+            if (v->IsBigInt()) {
+                rv = bigint_to_double(v.As<v8::BigInt>());
+                return 0;
+            }
+            break;
+
+        case QV8_FT_BOOL:
+            rv = v->BooleanValue(isolate);
+            return 0;
+
+        case QV8_FT_STRING:
+            if (v->IsString()) {
+                rv = QoreV8Program::getQoreString(isolate, v.As<v8::String>());
+                return 0;
+            }
+            break;
+
+        case QV8_FT_AUTO: {
+            ExceptionSink xsink;
+            rv = tf->pgm->getQoreValue(&xsink, v);
+            if (xsink) {
+                QoreV8Program::raiseV8Exception(xsink, isolate);
+                return -1;
+            }
+            return 0;
+        }
+    }
+
+    static const char* type_names[] = {"auto", "int", "float", "bool", "string"};
+    QoreStringMaker str("argument %u: expecting a value compatible with '%s'", i + 1, type_names[tf->arg_types[i]]);
+    v8::MaybeLocal<v8::String> msg = v8::String::NewFromUtf8(isolate, str.c_str(), v8::NewStringType::kNormal);
+    if (!msg.IsEmpty()) {
+        isolate->ThrowException(v8::Exception::TypeError(msg.ToLocalChecked()));
+    }
+    return -1;
+}
+
+static void call_typed_function(const v8::FunctionCallbackInfo<v8::Value>& info) {
+    v8::Local<v8::Value> v = info.Data();
+    assert(v->IsExternal());
+    QoreV8TypedFunction* tf = reinterpret_cast<QoreV8TypedFunction*>(v8::Local<v8::External>::Cast(v)->Value());
+
+    v8::Isolate* isolate = info.GetIsolate();
+    ExceptionSink xsink;
+    OptionalCallReferenceAccessHelper rh(&xsink, tf->code);
+    if (!rh) {
+        assert(xsink);
+        // raise JS exception
+        QoreV8Program::raiseV8Exception(xsink, isolate);
+        return;
+    }
+
+    // take the reusable argument list; a nested or concurrent call allocates its own
+    unsigned nargs = tf->arg_types.size();
+    ReferenceHolder<QoreListNode> args(&xsink);
+    if (nargs) {
+        if (tf->args) {
+            args = tf->args;
+            tf->args = nullptr;
+        } else {
+            args = new QoreListNode(autoTypeInfo);
+            args->getEntryReference(nargs - 1);
+        }
+        int len = info.Length();
+        for (unsigned i = 0; i < nargs; ++i) {
+            QoreValue& arg = args->getEntryReference(i);
+            if (get_typed_arg(tf, isolate, (int)i < len ? info[i] : v8::Local<v8::Value>(v8::Undefined(isolate)), i,
+                arg)) {
+                return;
+            }
+        }
+    }
+
+    ValueHolder rv(tf->code->execValue(*args, &xsink), &xsink);
+
+    // clear the arguments and keep the list for the next call if it is not referenced by the code
+    if (args && args->reference_count() == 1 && !tf->args) {
+        for (unsigned i = 0; i < nargs; ++i) {
+            QoreValue& arg = args->getEntryReference(i);
+            arg.discard(&xsink);
+            arg = QoreValue();
+        }
+        tf->args = args.release();
+    }
+
+    if (xsink) {
+        QoreV8Program::raiseV8Exception(xsink, isolate);
+        return;
+    }
+
+    switch (tf->rv_type) {
+        case QV8_FT_INT: {
+            int64 i = rv->getAsBigInt();
+            if (i >= INT_MIN && i <= INT_MAX) {
+                info.GetReturnValue().Set((int32_t)i);
+            } else {
+                info.GetReturnValue().Set(v8::BigInt::New(isolate, i));
+            }
+            return;
+        }
+        case QV8_FT_FLOAT:
+            info.GetReturnValue().Set(rv->getAsFloat());
+            return;
+        case QV8_FT_BOOL:
+            info.GetReturnValue().Set(rv->getAsBool());
+            return;
+        default:
+            break;
+    }
+
+    v8::Local<v8::Value> v8rv = tf->pgm->getV8Value(*rv, &xsink);
+    if (xsink) {
+        QoreV8Program::raiseV8Exception(xsink, isolate);
+        return;
+    }
+    info.GetReturnValue().Set(v8rv);
+}
+
+QoreObject* QoreV8Program::registerFunction(ExceptionSink* xsink, const QoreString& name,
+        const ResolvedCallReferenceNode* code, const QoreListNode* arg_types, const QoreString& rv_type) {
+    std::vector<qv8_func_type_e> types;
+    if (arg_types) {
+        if (arg_types->size() > QV8_MAX_FUNC_ARGS) {
+            xsink->raiseException("JAVASCRIPT-FUNCTION-ERROR", "cannot register a function with %zu arguments; the "
+                "maximum is %u", arg_types->size(), QV8_MAX_FUNC_ARGS);
+            return nullptr;
+        }
+        for (size_t i = 0, e = arg_types->size(); i < e; ++i) {
+            QoreStringValueHelper str(arg_types->retrieveEntry(i));
+            qv8_func_type_e t;
+            if (get_func_type(xsink, str->c_str(), t)) {
+                return nullptr;
+            }
+            types.push_back(t);
+        }
+    }
+    qv8_func_type_e rt;
+    if (get_func_type(xsink, rv_type.c_str(), rt)) {
+        return nullptr;
+    }
+
+    QoreV8ProgramHelper v8h(xsink, this);
+    if (*xsink) {
+        return nullptr;
+    }
+
+    v8::TryCatch tryCatch(isolate);
+    v8::Local<v8::Context> context = v8h.getContext();
+    std::unique_ptr<QoreV8TypedFunction> tf(new QoreV8TypedFunction(this, code, std::move(types), rt));
+    v8::Local<v8::FunctionTemplate> tmpl = v8::FunctionTemplate::New(isolate, call_typed_function,
+        v8::External::New(isolate, tf.get()), v8::Local<v8::Signature>(), (int)tf->arg_types.size(),
+        v8::ConstructorBehavior::kThrow);
+    v8::MaybeLocal<v8::Function> func = tmpl->GetFunction(context);
+    if (func.IsEmpty()) {
+        checkException(xsink, tryCatch);
+        tf->release(xsink);
+        return nullptr;
+    }
+    v8::Local<v8::Function> f = func.ToLocalChecked();
+    v8::MaybeLocal<v8::String> fname = v8::String::NewFromUtf8(isolate, name.c_str(), v8::NewStringType::kInternalized);
+    if (fname.IsEmpty()) {
+        checkException(xsink, tryCatch);
+        tf->release(xsink);
+        return nullptr;
+    }
+    f->SetName(fname.ToLocalChecked());
+    if (global.Get(isolate)->Set(context, fname.ToLocalChecked(), f).IsNothing()) {
+        checkException(xsink, tryCatch);
+        tf->release(xsink);
+        return nullptr;
+    }
+    typed_functions.push_back(tf.release());
+    return new QoreObject(QC_JAVASCRIPTOBJECT, getProgram(), new QoreV8Object(this, f));
+}
+
+QoreObject* QoreV8Program::getAsyncFunction(ExceptionSink* xsink, const ResolvedCallReferenceNode* code) {
+    QoreV8ProgramHelper v8h(xsink, this);
+    if (*xsink) {
+        return nullptr;
+    }
+
+    v8::EscapableHandleScope handle_scope(isolate);
+    v8::TryCatch tryCatch(isolate);
+    v8::MaybeLocal<v8::Function> func = getV8Function(xsink, code, tryCatch, handle_scope, true);
+    if (func.IsEmpty()) {
+        return nullptr;
+    }
+    return new QoreObject(QC_JAVASCRIPTOBJECT, getProgram(), new QoreV8Object(this, func.ToLocalChecked()));
+}
+
+int QoreV8Program::startAsyncCall(ExceptionSink* xsink, ResolvedCallReferenceNode* code, QoreListNode* args,
+        v8::Local<v8::Promise::Resolver> resolver) {
+    {
+        AutoLocker al(async_lock);
+        if (!async_ready) {
+            if (!valid) {
+                xsink->raiseException("JAVASCRIPT-PROGRAM-ERROR", "The given JavaScriptProgram has been destroyed "
+                    "and can no longer be accessed");
+            } else {
+                uv_async_init(setup->event_loop(), &async_handle, async_call_callback);
+                async_handle.data = this;
+                // the handle only keeps the loop alive while calls are pending
+                uv_unref(reinterpret_cast<uv_handle_t*>(&async_handle));
+                async_ready = true;
+            }
+        }
+    }
+
+    QoreV8AsyncCall* call = new QoreV8AsyncCall(this, ++async_seq, code, args);
+    if (*xsink || QoreV8AsyncWorkerPool::submit(xsink, call)) {
+        call->release(xsink);
+        delete call;
+        return -1;
+    }
+    async_resolvers[call->id].Reset(isolate, resolver);
+    if (!async_pending++) {
+        uv_ref(reinterpret_cast<uv_handle_t*>(&async_handle));
+    }
+    return 0;
+}
+
+void QoreV8Program::postAsyncCall(QoreV8AsyncCall* call) {
+    {
+        AutoLocker al(async_lock);
+        if (async_ready) {
+            async_done.push_back(call);
+            uv_async_send(&async_handle);
+            return;
+        }
+    }
+    // the program has been destroyed
+    ExceptionSink xsink;
+    call->release(&xsink);
+    delete call;
+}
+
+void QoreV8Program::async_call_callback(uv_async_t* handle) {
+    reinterpret_cast<QoreV8Program*>(handle->data)->processAsyncCalls();
+}
+
+void QoreV8Program::processAsyncCalls() {
+    std::deque<QoreV8AsyncCall*> calls;
+    {
+        AutoLocker al(async_lock);
+        calls.swap(async_done);
+    }
+
+    v8::HandleScope handle_scope(isolate);
+    v8::Local<v8::Context> context = setup->context();
+    v8::Context::Scope context_scope(context);
+
+    ExceptionSink xsink;
+    for (QoreV8AsyncCall* call : calls) {
+        auto i = async_resolvers.find(call->id);
+        if (i != async_resolvers.end()) {
+            v8::Local<v8::Promise::Resolver> resolver = i->second.Get(isolate);
+            async_resolvers.erase(i);
+
+            v8::Local<v8::Value> v;
+            if (!call->xsink) {
+                v = getV8Value(call->rv, &call->xsink);
+            }
+            // errors settling the Promise are ignored, as the program may be terminating
+            if (call->xsink) {
+                v = getV8ExceptionValue(call->xsink, isolate);
+                if (!v.IsEmpty()) {
+                    resolver->Reject(context, v).IsNothing();
+                }
+            } else {
+                resolver->Resolve(context, v).IsNothing();
+            }
+        }
+        call->release(&xsink);
+        delete call;
+        assert(async_pending);
+        if (!--async_pending) {
+            uv_unref(reinterpret_cast<uv_handle_t*>(&async_handle));
+        }
+    }
+    isolate->PerformMicrotaskCheckpoint();
+}
+
+void QoreV8Program::closeAsyncCalls(ExceptionSink* xsink) {
+    std::deque<QoreV8AsyncCall*> calls;
+    {
+        AutoLocker al(async_lock);
+        if (!async_ready) {
+            return;
+        }
+        async_ready = false;
+        calls.swap(async_done);
+    }
+    for (QoreV8AsyncCall* call : calls) {
+        call->release(xsink);
+        delete call;
+    }
+
+    v8::Locker locker(isolate);
+    v8::Isolate::Scope isolate_scope(isolate);
+    async_resolvers.clear();
+    async_pending = 0;
+    uv_close(reinterpret_cast<uv_handle_t*>(&async_handle), nullptr);
+    // process the close of the handle
+    uv_run(setup->event_loop(), UV_RUN_NOWAIT);
 }
 
 QoreObject* QoreV8Program::getGlobal(ExceptionSink* xsink) {
@@ -718,4 +2478,25 @@ QoreObject* QoreV8Program::getGlobal(ExceptionSink* xsink) {
 
     v8::Local<v8::Object> g = global.Get(isolate);
     return new QoreObject(QC_JAVASCRIPTOBJECT, getProgram(), new QoreV8Object(this, g));
-}
\ No newline at end of file
+}
+
+QoreHashNode* QoreV8Program::getHeapStatistics(ExceptionSink* xsink) {
+    QoreV8ProgramHelper v8h(xsink, this);
+    if (*xsink) {
+        return nullptr;
+    }
+
+    v8::HeapStatistics hs;
+    isolate->GetHeapStatistics(&hs);
+
+    ReferenceHolder<QoreHashNode> rv(new QoreHashNode(bigIntTypeInfo), xsink);
+    rv->setKeyValue("total_heap_size", (int64)hs.total_heap_size(), xsink);
+    rv->setKeyValue("used_heap_size", (int64)hs.used_heap_size(), xsink);
+    rv->setKeyValue("heap_size_limit", (int64)hs.heap_size_limit(), xsink);
+    rv->setKeyValue("malloced_memory", (int64)hs.malloced_memory(), xsink);
+    rv->setKeyValue("external_memory", (int64)hs.external_memory(), xsink);
+    rv->setKeyValue("total_global_handles_size", (int64)hs.total_global_handles_size(), xsink);
+    rv->setKeyValue("used_global_handles_size", (int64)hs.used_global_handles_size(), xsink);
+    rv->setKeyValue("number_of_native_contexts", (int64)hs.number_of_native_contexts(), xsink);
+    return rv.release();
+}
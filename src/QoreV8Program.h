@@ -34,17 +34,177 @@
 #define _QORE_QOREV8PROGRAM
 
 #include "v8-module.h"
+#include "QoreV8Snapshot.h"
+#include "QoreV8EventLoop.h"
+#include "QoreV8AsyncCall.h"
 
 #include <set>
 #include <map>
 #include <memory>
+#include <functional>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+#include <optional>
+
+class QoreV8ProgramPool;
+
+//! Cached object shape for converting hashes with the same keys to JavaScript objects
+struct QoreV8ObjectShape {
+    // template for objects with the shape
+    v8::Global<v8::ObjectTemplate> tmpl;
+    // internalized key strings in hash order
+    std::vector<v8::Global<v8::String>> keys;
+    // the hash keys in order, to check for signature hash collisions
+    std::vector<std::string> names;
+};
+
+//! Cached internalized string for a hash key
+struct QoreV8KeyString {
+    // the key; the key cache refers to this string's memory
+    std::string key;
+    v8::Global<v8::String> str;
+};
+
+struct QoreV8ClassInfo;
+
+//! A JavaScript function for a method of a %Qore class exposed to JavaScript
+struct QoreV8ClassMethod {
+    QoreV8ClassInfo* cls_info = nullptr;
+    std::string name;
+    // empty if the name is not a method of the class
+    v8::Global<v8::Function> func;
+};
+
+//! Cached template and methods for a %Qore class exposed to JavaScript
+struct QoreV8ClassInfo {
+    QoreV8Program* pgm;
+    const QoreClass* cls;
+    v8::Global<v8::FunctionTemplate> tmpl;
+    // method functions by name; created on first access
+    std::unordered_map<std::string, QoreV8ClassMethod> methods;
+
+    DLLLOCAL QoreV8ClassInfo(QoreV8Program* pgm, const QoreClass* cls) : pgm(pgm), cls(cls) {
+    }
+};
+
+//! %Qore strings of at least this size that only contain ASCII data are passed to JavaScript without copying
+constexpr size_t QV8_EXTERNAL_STRING_MIN = 16384;
+
+//! An external JavaScript string backed by the buffer of a %Qore string with only ASCII data
+/** the %Qore string is referenced until the JavaScript string is collected
+*/
+class QoreV8ExternalString : public v8::String::ExternalOneByteStringResource {
+public:
+    DLLLOCAL QoreV8ExternalString(const QoreStringNode* str) : str(str->stringRefSelf()) {
+    }
+
+    DLLLOCAL virtual ~QoreV8ExternalString() {
+        str->deref();
+    }
+
+    DLLLOCAL virtual const char* data() const {
+        return str->c_str();
+    }
+
+    DLLLOCAL virtual size_t length() const {
+        return str->size();
+    }
+
+private:
+    QoreStringNode* str;
+};
+
+//! Conversion option: convert homogeneous lists of ints or floats to typed arrays
+constexpr int QV8_CO_TYPED_ARRAYS = (1 << 0);
+//! Conversion option: convert all typed arrays to binary values
+constexpr int QV8_CO_TYPED_ARRAY_BINARY = (1 << 1);
+//! Conversion option: expose hashes and lists to JavaScript as read-only proxies instead of copying them
+constexpr int QV8_CO_LAZY_CONTAINERS = (1 << 2);
+
+//! Argument and return value types for functions registered with QoreV8Program::registerFunction()
+enum qv8_func_type_e : unsigned char {
+    QV8_FT_AUTO = 0,
+    QV8_FT_INT = 1,
+    QV8_FT_FLOAT = 2,
+    QV8_FT_BOOL = 3,
+    QV8_FT_STRING = 4,
+};
+
+//! The maximum number of arguments for functions registered with QoreV8Program::registerFunction()
+constexpr unsigned QV8_MAX_FUNC_ARGS = 16;
+
+//! A %Qore function registered in a program with typed arguments and return value
+struct QoreV8TypedFunction {
+    QoreV8Program* pgm;
+    //! the code to call; a strong reference is held as long as the program is valid
+    ResolvedCallReferenceNode* code;
+    std::vector<qv8_func_type_e> arg_types;
+    qv8_func_type_e rv_type;
+    //! argument list reused between calls if not referenced by the code; only accessed with the isolate locked
+    QoreListNode* args = nullptr;
+
+    DLLLOCAL QoreV8TypedFunction(QoreV8Program* pgm, const ResolvedCallReferenceNode* code,
+            std::vector<qv8_func_type_e>&& arg_types, qv8_func_type_e rv_type)
+            : pgm(pgm), code(code->refRefSelf()), arg_types(std::move(arg_types)), rv_type(rv_type) {
+    }
+
+    DLLLOCAL void release(ExceptionSink* xsink) {
+        code->deref(xsink);
+        if (args) {
+            args->deref(xsink);
+        }
+    }
+};
+
+//! A reference to a %Qore value held for a JavaScript object
+struct QoreV8SavedReference {
+    //! the program; only valid until the holder has been collected
+    QoreV8Program* pgm;
+    //! the referenced value
+    QoreValue val;
+    //! weak reference to the JavaScript object holding the value
+    v8::Global<v8::Value> holder;
+
+    DLLLOCAL QoreV8SavedReference(QoreV8Program* pgm, QoreValue val) : pgm(pgm), val(val) {
+    }
+};
+
+//! Data for a JavaScript function that calls %Qore code
+struct QoreV8CallbackInfo {
+    ResolvedCallReferenceNode* ref;
+    QoreV8Program* pgm;
+    //! weak reference to the function; the info is deleted when the function is collected
+    v8::Global<v8::Function> func;
+    //! true if the function runs the code asynchronously
+    bool async;
+
+    DLLLOCAL QoreV8CallbackInfo(const ResolvedCallReferenceNode* ref, QoreV8Program* pgm, bool async = false)
+            : ref(const_cast<ResolvedCallReferenceNode*>(ref)), pgm(pgm), async(async) {
+        this->ref->weakRef();
+    }
+
+    DLLLOCAL ~QoreV8CallbackInfo() {
+        ref->weakDeref();
+    }
+};
 
 class QoreV8Program : public AbstractQoreProgramExternalData {
     friend class QoreV8ProgramHelper;
+    friend class QoreV8ProgramSession;
     friend class QoreV8ProgramOperationHelper;
     friend class QoreV8Object;
 public:
-    DLLLOCAL QoreV8Program(const QoreString& source_code, const QoreString& source_label, ExceptionSink* xsink);
+    //! Creates the program from source; if \a require_dir is set, require() resolves modules relative to it
+    DLLLOCAL QoreV8Program(const QoreString& source_code, const QoreString& source_label, ExceptionSink* xsink,
+            const QoreString* require_dir = nullptr);
+
+    //! Creates the program from a startup snapshot
+    DLLLOCAL QoreV8Program(QoreV8Snapshot* snapshot, ExceptionSink* xsink, const QoreString* require_dir = nullptr);
 
     DLLLOCAL QoreV8Program(const QoreV8Program& old, QoreProgram* qpgm);
 
@@ -76,16 +236,103 @@ public:
     //! Returns a V8 value for the given Qore value
     DLLLOCAL v8::Local<v8::Value> getV8Value(const QoreValue val, ExceptionSink* xsink);
 
+    //! Converts the given JavaScript string to a %Qore string
+    DLLLOCAL static QoreStringNode* getQoreString(v8::Isolate* isolate, v8::Local<v8::String> str);
+
+    //! Returns the %Qore value for a container proxy or object wrapper, or no value if the object is neither
+    /** the value returned is referenced for the caller
+    */
+    DLLLOCAL QoreValue getProxiedValue(v8::Local<v8::Object> obj) const {
+        return getProxiedContainer(obj).refSelf();
+    }
+
     //! Returns a callable function object for the given Qore callable data
+    /** if \a async is true, the function returns a Promise, and the %Qore code is run in a worker thread
+    */
     DLLLOCAL v8::MaybeLocal<v8::Function> getV8Function(ExceptionSink* xsink, const ResolvedCallReferenceNode* call,
-            const v8::TryCatch& tryCatch, v8::EscapableHandleScope& handle_scope);
+            const v8::TryCatch& tryCatch, v8::EscapableHandleScope& handle_scope, bool async = false);
+
+    //! Removes the callback info from the function cache; called when the function is collected
+    DLLLOCAL void removeCallbackInfo(QoreV8CallbackInfo* cbinfo);
+
+    //! Registers a %Qore function with typed arguments and return value as a global JavaScript function
+    /** Arguments are converted directly according to their declared types without the generic conversion
+        dispatch, and the argument list is reused between calls
+    */
+    DLLLOCAL QoreObject* registerFunction(ExceptionSink* xsink, const QoreString& name,
+            const ResolvedCallReferenceNode* code, const QoreListNode* arg_types, const QoreString& rv_type);
+
+    //! Returns a JavaScript function that runs the given code asynchronously and returns a Promise
+    DLLLOCAL QoreObject* getAsyncFunction(ExceptionSink* xsink, const ResolvedCallReferenceNode* code);
+
+    //! Starts an asynchronous call of the given code; must be called with the isolate locked
+    /** takes ownership of the references to \a code and \a args in all cases
+
+        @return 0 for OK, -1 if an error occurred
+    */
+    DLLLOCAL int startAsyncCall(ExceptionSink* xsink, ResolvedCallReferenceNode* code, QoreListNode* args,
+            v8::Local<v8::Promise::Resolver> resolver);
+
+    //! Passes a completed asynchronous call to the program's event loop; called in worker threads
+    /** takes ownership of \a call
+    */
+    DLLLOCAL void postAsyncCall(QoreV8AsyncCall* call);
 
     //! Checks if a JavaScript exception has been thrown and throws the corresponding Qore exception
-    DLLLOCAL int checkException(ExceptionSink* xsink, const v8::TryCatch& tryCatch) const;
+    DLLLOCAL int checkException(ExceptionSink* xsink, const v8::TryCatch& tryCatch) const {
+        return checkException(xsink, isolate, tryCatch);
+    }
+
+    //! Checks if a JavaScript exception has been thrown in the given isolate and throws the Qore exception
+    DLLLOCAL static int checkException(ExceptionSink* xsink, v8::Isolate* isolate, const v8::TryCatch& tryCatch);
 
     //! Returns the global proxy object
     DLLLOCAL QoreObject* getGlobal(ExceptionSink* xsink);
 
+    //! Calls the given code with a session that holds the isolate lock and scopes for all operations
+    DLLLOCAL QoreValue runInSession(ExceptionSink* xsink, const ResolvedCallReferenceNode* code,
+            const QoreListNode* args);
+
+    //! Returns heap statistics for the program's isolate
+    DLLLOCAL QoreHashNode* getHeapStatistics(ExceptionSink* xsink);
+
+    //! Returns an internalized string for the given hash key from the key cache
+    DLLLOCAL v8::MaybeLocal<v8::String> getKeyString(const char* key) {
+        return getKeyString(key, strlen(key));
+    }
+
+    //! Returns an internalized string for the given hash key from the key cache
+    DLLLOCAL v8::MaybeLocal<v8::String> getKeyString(const char* key, size_t len);
+
+    //! Sets data conversion options from the given hash; unknown options raise an exception
+    DLLLOCAL int setConversionOptions(ExceptionSink* xsink, const QoreHashNode* opts);
+
+    //! Returns a hash of data conversion options
+    DLLLOCAL QoreHashNode* getConversionOptions() const;
+
+    //! Converts the elements of a JavaScript array to the given empty list
+    /** Elements that can be converted without calling into V8 are converted directly; all other elements are
+        converted with \a conv.  Dense arrays are converted into a preallocated list; large sparse arrays are
+        converted by iterating their index keys.
+
+        @return 0 for OK, -1 if an error occurred; if no %Qore exception has been raised, a JavaScript exception was
+        thrown
+    */
+    DLLLOCAL static int getList(ExceptionSink* xsink, v8::Isolate* isolate, v8::Local<v8::Context> context,
+            v8::Local<v8::Array> array, QoreListNode* l,
+            const std::function<QoreValue(v8::Local<v8::Value>)>& conv);
+
+    //! Converts the entries of a JavaScript Map to the given empty hash
+    /** Map keys are converted to strings; all values are converted with \a conv.
+
+        @return 0 for OK, -1 if an error occurred, 1 if the Map has keys that are not strings or numbers or keys
+        that are converted to the same string, such as \c 1 and \c "1"; if -1 is returned and no %Qore exception
+        has been raised, a JavaScript exception was thrown
+    */
+    DLLLOCAL static int getHash(ExceptionSink* xsink, v8::Isolate* isolate, v8::Local<v8::Context> context,
+            v8::Local<v8::Map> map, QoreHashNode* h,
+            const std::function<QoreValue(v8::Local<v8::Value>)>& conv);
+
     //! Returns the pointer to the isolate
     v8::Isolate* getIsolate() const {
         return isolate;
@@ -103,8 +350,56 @@ public:
         return *save_ref_callback;
     }
 
+    //! Sets the pool the program belongs to
+    DLLLOCAL void setPool(QoreV8ProgramPool* pool, unsigned index, bool first) {
+        this->pool = pool;
+        pool_index = index;
+        pool_first = first;
+    }
+
+    //! Returns the pool the program belongs to, if any
+    DLLLOCAL QoreV8ProgramPool* getPool() const {
+        return pool;
+    }
+
+    //! Returns the slot index of the program in its pool
+    DLLLOCAL unsigned getPoolIndex() const {
+        return pool_index;
+    }
+
+    //! Returns true if the program was the first program created by its pool
+    DLLLOCAL bool isPoolFirst() const {
+        return pool_first;
+    }
+
     DLLLOCAL int spinOnce();
 
+    //! Returns the program's libuv event loop
+    DLLLOCAL uv_loop_t* getEventLoop() const {
+        return setup->event_loop();
+    }
+
+    //! Returns the program's context
+    DLLLOCAL v8::Local<v8::Context> getContext() const {
+        return setup->context();
+    }
+
+    //! Starts a thread that owns and runs the program's event loop
+    DLLLOCAL int startEventLoopThread(ExceptionSink* xsink);
+
+    //! Stops the event loop thread, if running
+    DLLLOCAL void stopEventLoopThread();
+
+    //! Returns the event loop thread if it is running, otherwise nullptr
+    DLLLOCAL QoreV8EventLoop* getEventLoopThread() const {
+        QoreV8EventLoop* el = event_loop.load(std::memory_order_acquire);
+        return el && el->isRunning() ? el : nullptr;
+    }
+
+    //! Calls the given code in the event loop thread and returns the result
+    DLLLOCAL QoreValue runInEventLoop(ExceptionSink* xsink, const ResolvedCallReferenceNode* code,
+            const QoreListNode* args);
+
     DLLLOCAL int spinEventLoop();
 
     DLLLOCAL void setObject(QoreObject* self) {
@@ -136,9 +431,35 @@ public:
     //! Raises an exception in the given isolate from the Qore exception
     DLLLOCAL static void raiseV8Exception(ExceptionSink& xsink, v8::Isolate* isolate);
 
+    //! Returns the JavaScript exception value for the given Qore exception and clears the exception
+    DLLLOCAL static v8::Local<v8::Value> getV8ExceptionValue(ExceptionSink& xsink, v8::Isolate* isolate);
+
     DLLLOCAL static void shutdown();
 
-    DLLLOCAL int saveQoreReference(const QoreValue& rv, ExceptionSink& xsink);
+    //! Saves a reference to the given %Qore value for as long as the given JavaScript value is reachable
+    /** If a save reference callback is set, it is called with the value instead.  The reference is otherwise kept in
+        the program's table of saved references and released when \a holder is collected by V8.
+    */
+    DLLLOCAL int saveQoreReference(const QoreValue& rv, v8::Local<v8::Value> holder, ExceptionSink& xsink);
+
+    //! Keeps a reference to the given value until \a holder is collected by V8
+    DLLLOCAL void holdQoreReference(const QoreValue& rv, v8::Local<v8::Value> holder);
+
+    //! Returns the number of saved references to %Qore values held for JavaScript objects
+    DLLLOCAL int64 getSavedReferenceCount() const {
+        return saved_ref_count.load(std::memory_order_relaxed);
+    }
+
+    //! Removes a saved reference from the program after its JavaScript holder has been collected
+    /** The value is released in the second-pass weak callback, which may run after the program has been deleted
+    */
+    DLLLOCAL void detachSavedReference(QoreV8SavedReference* ref);
+
+    //! Compiles and runs the given source in the given context as a script with the label as its origin
+    /** if \a use_cache is true, the code cache is used for compiling the source
+    */
+    DLLLOCAL static int runSource(ExceptionSink* xsink, v8::Isolate* isolate, v8::Local<v8::Context> context,
+            const QoreString& source, const QoreString& label, const v8::TryCatch& tryCatch, bool use_cache = true);
 
 protected:
     std::unique_ptr<node::CommonEnvironmentSetup> setup;
@@ -148,6 +469,62 @@ protected:
     QoreString source;
     QoreString label;
 
+    // the startup snapshot the program was created from, if any
+    QoreV8Snapshot* snapshot = nullptr;
+    // the base directory for require(); if empty, the current working directory is used
+    QoreString require_dir;
+
+    // data conversion option flags
+    std::atomic<int> conv_opts = {0};
+
+    // the event loop thread, created when first started and deleted with the program
+    std::atomic<QoreV8EventLoop*> event_loop = {nullptr};
+
+    // JavaScript functions for Qore call references; the call reference is kept valid with a weak reference by the
+    // callback info; only accessed with the isolate locked
+    typedef std::unordered_map<const ResolvedCallReferenceNode*, QoreV8CallbackInfo*> callback_map_t;
+    callback_map_t callback_cache;
+    callback_map_t async_callback_cache;
+
+    // functions registered with registerFunction(); deleted with the program
+    std::vector<QoreV8TypedFunction*> typed_functions;
+
+    // references to Qore values held for JavaScript objects; only accessed with the isolate locked
+    std::unordered_set<QoreV8SavedReference*> saved_refs;
+    std::atomic<int64> saved_ref_count = {0};
+
+    // completed asynchronous Qore calls waiting to be processed in the event loop
+    QoreThreadLock async_lock;
+    std::deque<QoreV8AsyncCall*> async_done;
+    // signals completed asynchronous calls to the event loop
+    uv_async_t async_handle;
+    // true if async_handle has been initialized and not closed; protected by async_lock
+    bool async_ready = false;
+    // the number of pending asynchronous calls; only accessed with the isolate locked
+    unsigned async_pending = 0;
+    // Promise resolvers for pending asynchronous calls; only accessed with the isolate locked
+    std::unordered_map<int64, v8::Global<v8::Promise::Resolver>> async_resolvers;
+    int64 async_seq = 0;
+
+    // internalized hash key strings; only accessed with the isolate locked
+    std::unordered_map<std::string_view, std::unique_ptr<QoreV8KeyString>> key_cache;
+    // object shapes by hash key signature hash; only accessed with the isolate locked
+    std::unordered_map<size_t, QoreV8ObjectShape> shape_cache;
+    // signature hashes of key sequences seen once; only accessed with the isolate locked
+    std::unordered_set<size_t> shape_candidates;
+    // templates for read-only hash and list proxies; created on first use
+    v8::Global<v8::FunctionTemplate> hash_proxy_tmpl;
+    v8::Global<v8::FunctionTemplate> list_proxy_tmpl;
+    // base template for Qore object wrappers; all class templates inherit from it
+    v8::Global<v8::FunctionTemplate> qore_object_tmpl;
+    // templates and methods for Qore classes by class ID; only accessed with the isolate locked
+    std::unordered_map<qore_classid_t, std::unique_ptr<QoreV8ClassInfo>> class_cache;
+
+    // the pool the program belongs to, if any
+    QoreV8ProgramPool* pool = nullptr;
+    unsigned pool_index = 0;
+    bool pool_first = false;
+
     v8::Global<v8::Object> global;
 
     QoreObject* self = nullptr;
@@ -166,18 +543,59 @@ protected:
     typedef std::set<QoreV8Program*> pset_t;
     static pset_t pset;
 
-    static QoreString scont;
-
-    //! protected constructor
-    DLLLOCAL QoreV8Program();
+    //! protected constructor; creates the environment from the snapshot if given
+    DLLLOCAL QoreV8Program(QoreV8Snapshot* snapshot = nullptr);
 
     DLLLOCAL int init(ExceptionSink* xsink);
 
-    DLLLOCAL void deleteIntern(ExceptionSink* xsink);
+    //! Settles the Promises of completed asynchronous calls; called in the event loop
+    DLLLOCAL void processAsyncCalls();
+
+    //! Closes the handle for asynchronous calls and discards any completed calls
+    DLLLOCAL void closeAsyncCalls(ExceptionSink* xsink);
+
+    DLLLOCAL static void async_call_callback(uv_async_t* handle);
+
+    //! Deletes all callback info objects in the given cache
+    DLLLOCAL static void clearCallbackCache(callback_map_t& cache);
+
+    //! Registers an operation on the program; returns -1 if the program is no longer valid
+    /** if \a silent is true, no exception is raised if the program is not valid
+    */
+    DLLLOCAL int beginOperation(ExceptionSink* xsink, bool silent);
+
+    //! Ends an operation on the program; destroys the program if it has been marked for destruction
+    DLLLOCAL void endOperation(ExceptionSink* xsink);
+
+    //! Returns the cached shape for the keys of the given hash, or nullptr if no template is available yet
+    DLLLOCAL QoreV8ObjectShape* getShape(const QoreHashNode* h);
+
+    //! Clears the key and shape caches if they have grown over their limits
+    /** must only be called with the isolate locked and no conversion in progress
+    */
+    DLLLOCAL void trimCaches();
+
+    //! Returns a read-only proxy object for the given hash or list
+    DLLLOCAL v8::MaybeLocal<v8::Object> getContainerProxy(ExceptionSink* xsink, const QoreValue val,
+            const v8::TryCatch& tryCatch);
+
+    //! Returns the template for container proxies of the given type, creating it if necessary
+    DLLLOCAL v8::Local<v8::FunctionTemplate> getContainerProxyTemplate(bool list);
+
+    //! Returns the %Qore value for a container proxy or object wrapper, or no value if the object is neither
+    DLLLOCAL QoreValue getProxiedContainer(v8::Local<v8::Object> obj) const;
 
-    DLLLOCAL int saveQoreReferenceDefault(const QoreValue& rv, ExceptionSink& xsink);
+    //! Returns a JavaScript object wrapping the given %Qore object
+    DLLLOCAL v8::MaybeLocal<v8::Object> getObjectWrapper(ExceptionSink* xsink, QoreObject* obj,
+            const v8::TryCatch& tryCatch);
 
-    DLLLOCAL static void escapeSingle(QoreString& str);
+    //! Replaces the public require() function with one that resolves modules relative to require_dir
+    DLLLOCAL int setRequireDir(ExceptionSink* xsink, v8::Local<v8::Context> context, const v8::TryCatch& tryCatch);
+
+    DLLLOCAL void deleteIntern(ExceptionSink* xsink);
+
+    //! Releases all saved references
+    DLLLOCAL void clearSavedReferences(ExceptionSink* xsink);
 };
 
 class QoreV8CallStack : public QoreCallStack {
@@ -189,11 +607,17 @@ public:
 
 class QoreV8ProgramData : public AbstractPrivateData, public QoreV8Program {
 public:
-    DLLLOCAL QoreV8ProgramData(const QoreString& source_code, const QoreString& source_label, ExceptionSink* xsink)
-            : QoreV8Program(source_code, source_label, xsink) {
+    DLLLOCAL QoreV8ProgramData(const QoreString& source_code, const QoreString& source_label, ExceptionSink* xsink,
+            const QoreString* require_dir = nullptr)
+            : QoreV8Program(source_code, source_label, xsink, require_dir) {
         //printd(5, "QoreV8ProgramData::QoreV8ProgramData() this: %p\n", this);
     }
 
+    DLLLOCAL QoreV8ProgramData(QoreV8Snapshot* snapshot, ExceptionSink* xsink,
+            const QoreString* require_dir = nullptr)
+            : QoreV8Program(snapshot, xsink, require_dir) {
+    }
+
     DLLLOCAL QoreV8ProgramData(ExceptionSink* xsink, const QoreV8ProgramData& old, QoreObject* self)
             : QoreV8Program(xsink, old, self) {
         //printd(5, "QoreV8ProgramData::QoreV8ProgramData() this: %p\n", this);
@@ -216,42 +640,111 @@ private:
     }
 };
 
-class QoreV8ProgramHelper {
+//! Acquires the isolate lock and enters the isolate unless already entered by a session
+class QoreV8IsolateEntry {
 public:
-    DLLLOCAL QoreV8ProgramHelper(ExceptionSink* xsink, QoreV8Program* pgm, bool silent = false) :
+    DLLLOCAL QoreV8IsolateEntry(v8::Isolate* isolate, bool enter) {
+        if (enter) {
+            locker.emplace(isolate);
+            isolate_scope.emplace(isolate);
+        }
+    }
+
+private:
+    std::optional<v8::Locker> locker;
+    std::optional<v8::Isolate::Scope> isolate_scope;
+};
+
+//! Holds the isolate lock and scopes for a program across many operations on the current thread
+/** QoreV8ProgramHelper objects created for the same program on the same thread while the session is active reuse
+    the session's lock, scopes, and operation registration
+*/
+class QoreV8ProgramSession {
+public:
+    DLLLOCAL QoreV8ProgramSession(ExceptionSink* xsink, QoreV8Program* pgm) :
             locker(pgm->isolate),
             isolate_scope(pgm->isolate),
             handle_scope(pgm->isolate),
-            tryCatch(pgm->isolate),
-            //origin(pgm->isolate, pgm->label.Get(pgm->isolate)),
             context(pgm->setup->context()),
             context_scope(context) {
-        AutoLocker al(pgm->m);
-        if (!pgm->valid) {
-            if (!silent) {
-                xsink->raiseException("JAVASCRIPT-PROGRAM-ERROR", "The given JavaScriptProgram has been destroyed "
-                    "and can no longer be accessed");
-            }
+        if (pgm->beginOperation(xsink, false)) {
             return;
         }
-        if (pgm->to_destroy) {
-            if (!silent) {
-                xsink->raiseException("JAVASCRIPT-PROGRAM-ERROR", "The given JavaScriptProgram has been marked for "
-                    "destruction and can no longer be accessed");
+        this->xsink = xsink;
+        this->pgm = pgm;
+        prev = current;
+        current = this;
+    }
+
+    DLLLOCAL ~QoreV8ProgramSession() {
+        if (pgm) {
+            assert(current == this);
+            current = prev;
+            QoreV8EventLoop* el = pgm->event_loop.load(std::memory_order_acquire);
+            if (el) {
+                el->wakeup();
+            }
+            pgm->endOperation(xsink);
+        }
+    }
+
+    DLLLOCAL operator bool() const {
+        return (bool) pgm;
+    }
+
+    //! Returns true if a session for the given program is active on the current thread
+    DLLLOCAL static bool isActive(const QoreV8Program* pgm) {
+        for (QoreV8ProgramSession* s = current; s; s = s->prev) {
+            if (s->pgm == pgm) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    QoreV8Program* pgm = nullptr;
+    ExceptionSink* xsink = nullptr;
+    // the enclosing session on the current thread
+    QoreV8ProgramSession* prev = nullptr;
+
+    v8::Locker locker;
+    v8::Isolate::Scope isolate_scope;
+    v8::HandleScope handle_scope;
+    v8::Local<v8::Context> context;
+    v8::Context::Scope context_scope;
+
+    // the innermost session on the current thread
+    DLLLOCAL static thread_local QoreV8ProgramSession* current;
+};
+
+class QoreV8ProgramHelper {
+public:
+    DLLLOCAL QoreV8ProgramHelper(ExceptionSink* xsink, QoreV8Program* pgm, bool silent = false) :
+            in_session(QoreV8ProgramSession::isActive(pgm)),
+            entry(pgm->isolate, !in_session),
+            handle_scope(pgm->isolate),
+            tryCatch(pgm->isolate),
+            //origin(pgm->isolate, pgm->label.Get(pgm->isolate)),
+            context(pgm->setup->context()) {
+        if (!in_session) {
+            context_scope.emplace(context);
+            if (pgm->beginOperation(xsink, silent)) {
+                return;
             }
-            return;
         }
-        ++pgm->opcount;
         this->xsink = xsink;
         this->pgm = pgm;
     }
 
     DLLLOCAL ~QoreV8ProgramHelper() {
-        if (pgm) {
-            AutoLocker al(pgm->m);
-            if (!--pgm->opcount && pgm->to_destroy) {
-                pgm->destructor(xsink);
+        if (pgm && !in_session) {
+            // the operation may have added timers or I/O to the loop
+            QoreV8EventLoop* el = pgm->event_loop.load(std::memory_order_acquire);
+            if (el) {
+                el->wakeup();
             }
+            pgm->endOperation(xsink);
         }
     }
 
@@ -284,13 +777,14 @@ private:
     QoreV8Program* pgm = nullptr;
     ExceptionSink* xsink = nullptr;
 
-    v8::Locker locker;
-    v8::Isolate::Scope isolate_scope;
+    // true if the isolate lock and scopes are held by a session on the current thread
+    bool in_session;
+    QoreV8IsolateEntry entry;
     v8::HandleScope handle_scope;
     v8::TryCatch tryCatch;
     //v8::ScriptOrigin origin;
     v8::Local<v8::Context> context;
-    v8::Context::Scope context_scope;
+    std::optional<v8::Context::Scope> context_scope;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,559 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+    QoreV8ProgramPool.cpp
+
+    Qore Programming Language
+
+    Copyright (C) 2024 Qore Technologies, s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+    DEALINGS IN THE SOFTWARE.
+
+    Note that the Qore library is released under a choice of three open-source
+    licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+    information.
+*/
+
+
+#include "QoreV8ProgramPool.h"
+#include "QoreV8Program.h"
+#include "QC_JavaScriptProgram.h"
+
+#include <climits>
+#include <vector>
+#include <unistd.h>
+
+// returns a timeout value in milliseconds for the given option value
+static int64 get_timeout_ms(const QoreValue v) {
+    if (v.getType() == NT_DATE) {
+        return v.get<const DateTimeNode>()->getRelativeMilliseconds();
+    }
+    return v.getAsBigInt();
+}
+
+void QoreV8ProgramPool::IndexStack::push(entry_t* entries, unsigned idx) {
+    uint64_t old_head = head.load();
+    while (true) {
+        entries[idx].next.store((uint32_t)old_head);
+        uint64_t new_head = (((old_head >> 32) + 1) << 32) | (idx + 1);
+        if (head.compare_exchange_weak(old_head, new_head)) {
+            return;
+        }
+    }
+}
+
+int QoreV8ProgramPool::IndexStack::pop(entry_t* entries) {
+    uint64_t old_head = head.load();
+    while (true) {
+        uint32_t top = (uint32_t)old_head;
+        if (top == NONE) {
+            return -1;
+        }
+        // the next value may be stale if the entry was popped concurrently, but then the tag will have changed and
+        // the exchange will fail
+        uint64_t new_head = (((old_head >> 32) + 1) << 32) | entries[top - 1].next.load();
+        if (head.compare_exchange_weak(old_head, new_head)) {
+            return (int)(top - 1);
+        }
+    }
+}
+
+QoreV8ProgramPool::QoreV8ProgramPool(ExceptionSink* xsink, QoreObject* self, const QoreString& source_code,
+        const QoreString& source_label, const ResolvedCallReferenceNode* init, const QoreHashNode* opts)
+        : self(self), source(source_code), label(source_label),
+        init(init ? init->refRefSelf() : nullptr) {
+    bool use_snapshot = false;
+    if (opts) {
+        QoreValue v = opts->getKeyValue("max");
+        if (v) {
+            int64 i = v.getAsBigInt();
+            if (i < 1 || i > INT_MAX) {
+                xsink->raiseException("JAVASCRIPT-POOL-ERROR", "invalid 'max' value " QLLD "; expecting a "
+                    "positive integer", i);
+                return;
+            }
+            max = (unsigned)i;
+        }
+        v = opts->getKeyValue("min");
+        if (v) {
+            int64 i = v.getAsBigInt();
+            if (i < 0 || i > max) {
+                xsink->raiseException("JAVASCRIPT-POOL-ERROR", "invalid 'min' value " QLLD "; expecting a value "
+                    "from 0 to the maximum size (%u)", i, max);
+                return;
+            }
+            min = (unsigned)i;
+        }
+        v = opts->getKeyValue("spare");
+        if (v) {
+            int64 i = v.getAsBigInt();
+            if (i < 0 || i > max) {
+                xsink->raiseException("JAVASCRIPT-POOL-ERROR", "invalid 'spare' value " QLLD "; expecting a value "
+                    "from 0 to the maximum size (%u)", i, max);
+                return;
+            }
+            spare = (unsigned)i;
+        }
+        v = opts->getKeyValue("idle_timeout");
+        if (v) {
+            idle_timeout_ms = get_timeout_ms(v);
+            if (idle_timeout_ms < 0) {
+                idle_timeout_ms = 0;
+            }
+        }
+        v = opts->getKeyValue("dir");
+        if (v) {
+            QoreStringValueHelper str(v);
+            dir = **str;
+        }
+        use_snapshot = opts->getKeyValue("snapshot").getAsBool();
+    }
+    if (dir.empty()) {
+        char buf[PATH_MAX];
+        if (getcwd(buf, sizeof buf)) {
+            dir.set(buf);
+        }
+    }
+
+    if (use_snapshot && QoreV8Snapshot::isSupported()) {
+        snapshot = new QoreV8Snapshot(source, label, xsink);
+        if (*xsink) {
+            return;
+        }
+    }
+
+    entries.reset(new entry_t[max]);
+    for (unsigned i = max; i; --i) {
+        empty_stack.push(entries.get(), i - 1);
+    }
+
+    // create the initial program synchronously
+    int idx = empty_stack.pop(entries.get());
+    assert(idx >= 0);
+    if (create(xsink, idx, true)) {
+        empty_stack.push(entries.get(), idx);
+        return;
+    }
+    pushFree(idx);
+
+    // start the background thread for pre-warming and eviction if required
+    if (min < 2 && !spare && !idle_timeout_ms) {
+        return;
+    }
+    ref();
+    bg_running = true;
+    if (q_start_thread(xsink, background_thread, this) < 0) {
+        bg_running = false;
+        deref();
+    }
+}
+
+QoreV8ProgramPool::~QoreV8ProgramPool() {
+    assert(!bg_running);
+    assert(!live.load());
+    if (snapshot) {
+        snapshot->deref();
+    }
+    if (bg_err) {
+        bg_err->deref();
+    }
+}
+
+void QoreV8ProgramPool::destructor(ExceptionSink* xsink) {
+    {
+        AutoLocker al(m);
+        bg_stop = true;
+        bg_cond.signal();
+        // the background thread may hold the last reference to the pool object if it is destroyed while
+        // running initialization code
+        if (bg_tid != q_gettid()) {
+            while (bg_running) {
+                bg_cond.wait(&m);
+            }
+        }
+    }
+
+    if (entries) {
+        for (unsigned i = 0; i < max; ++i) {
+            if (entries[i].obj) {
+                entries[i].pgm->setPool(nullptr, 0, false);
+                entries[i].pgm = nullptr;
+                entries[i].obj->deref(xsink);
+                entries[i].obj = nullptr;
+            }
+        }
+    }
+    live.store(0);
+    free_count.store(0);
+
+    if (init) {
+        init->deref(xsink);
+        init = nullptr;
+    }
+}
+
+QoreObject* QoreV8ProgramPool::get(ExceptionSink* xsink, int64 timeout_ms) {
+    // fast path: acquire a free program without locking
+    int idx = free_stack.pop(entries.get());
+    if (idx >= 0) {
+        --free_count;
+        ++hits;
+    } else {
+        int64 start = q_clock_getmicros();
+
+        AutoLocker al(m);
+        ++waiting;
+        bool timed_out = false;
+        bool waited = false;
+        // time spent creating a program, which is not included in the wait time
+        int64 create_time = 0;
+        while (true) {
+            idx = free_stack.pop(entries.get());
+            if (idx >= 0) {
+                --free_count;
+                ++hits;
+                break;
+            }
+            idx = empty_stack.pop(entries.get());
+            if (idx >= 0) {
+                // create the program without holding the lock, as initialization code may use the pool
+                int rc;
+                {
+                    AutoUnlocker aul(m);
+                    int64 create_start = q_clock_getmicros();
+                    rc = create(xsink, idx);
+                    create_time = q_clock_getmicros() - create_start;
+                }
+                if (rc) {
+                    empty_stack.push(entries.get(), idx);
+                }
+                break;
+            }
+            if (timed_out) {
+                break;
+            }
+            // only count requests that actually block waiting for a program to be released
+            if (!waited) {
+                waited = true;
+                ++waits;
+            }
+            if (timeout_ms < 0) {
+                cond.wait(&m);
+            } else {
+                int64 remaining = timeout_ms - (q_clock_getmicros() - start) / 1000;
+                if (remaining <= 0 || cond.wait(&m, (int)(remaining > INT_MAX ? INT_MAX : remaining))) {
+                    // check the stacks once more before timing out
+                    timed_out = true;
+                }
+            }
+        }
+        --waiting;
+
+        // only requests that blocked are included in the wait statistics; creation time is in create_us
+        if (waited) {
+            int64 us = q_clock_getmicros() - start - create_time;
+            wait_us += us;
+            int64 max_us = max_wait_us.load();
+            while (us > max_us && !max_wait_us.compare_exchange_weak(max_us, us)) {
+            }
+        }
+        bg_failed = false;
+
+        if (*xsink) {
+            return nullptr;
+        }
+        if (idx < 0) {
+            ++timeouts;
+            xsink->raiseException("JAVASCRIPT-POOL-TIMEOUT", "timeout acquiring a program from the pool for '%s' "
+                "after " QLLD " ms; all %u programs are in use", label.c_str(), timeout_ms, max);
+            return nullptr;
+        }
+    }
+
+    entries[idx].in_use.store(true);
+    checkSpare();
+    return entries[idx].obj->objectRefSelf();
+}
+
+int QoreV8ProgramPool::release(ExceptionSink* xsink, QoreV8Program* pgm) {
+    if (pgm->getPool() != this) {
+        xsink->raiseException("INVALID-PROGRAM", "The JavaScriptProgram passed was not provided from the pool");
+        return -1;
+    }
+    unsigned idx = pgm->getPoolIndex();
+    assert(idx < max);
+    assert(entries[idx].pgm == pgm);
+    if (!entries[idx].in_use.exchange(false)) {
+        xsink->raiseException("INVALID-PROGRAM", "The JavaScriptProgram passed was not allocated from the pool");
+        return -1;
+    }
+    entries[idx].last_used.store(q_clock_getmicros());
+    pushFree(idx);
+    return 0;
+}
+
+QoreObject* QoreV8ProgramPool::getPool(ExceptionSink* xsink, QoreV8Program* pgm) {
+    QoreV8ProgramPool* pool = pgm->getPool();
+    if (!pool) {
+        xsink->raiseException("ACTION-ERROR", "Cannot map program to a pool; the program was not created by a "
+            "JavaScriptProgramPool");
+        return nullptr;
+    }
+    return pool->getReferencedObject();
+}
+
+QoreHashNode* QoreV8ProgramPool::getStats() const {
+    ReferenceHolder<QoreHashNode> rv(new QoreHashNode(autoTypeInfo), nullptr);
+    int l = live.load();
+    int f = free_count.load();
+    if (f < 0) {
+        f = 0;
+    }
+    rv->setKeyValue("size", l, nullptr);
+    rv->setKeyValue("free", f, nullptr);
+    rv->setKeyValue("in_use", l > f ? l - f : 0, nullptr);
+    rv->setKeyValue("waiting", waiting.load(), nullptr);
+    rv->setKeyValue("min", (int64)min, nullptr);
+    rv->setKeyValue("max", (int64)max, nullptr);
+    rv->setKeyValue("spare", (int64)spare, nullptr);
+    rv->setKeyValue("idle_timeout", idle_timeout_ms, nullptr);
+    rv->setKeyValue("snapshot", (bool)snapshot, nullptr);
+    rv->setKeyValue("hits", hits.load(), nullptr);
+    rv->setKeyValue("creates", creates.load(), nullptr);
+    rv->setKeyValue("create_us", create_us.load(), nullptr);
+    rv->setKeyValue("evictions", evictions.load(), nullptr);
+    rv->setKeyValue("waits", waits.load(), nullptr);
+    rv->setKeyValue("wait_us", wait_us.load(), nullptr);
+    rv->setKeyValue("max_wait_us", max_wait_us.load(), nullptr);
+    rv->setKeyValue("timeouts", timeouts.load(), nullptr);
+    rv->setKeyValue("errors", errors.load(), nullptr);
+    {
+        AutoLocker al(m);
+        if (bg_err) {
+            rv->setKeyValue("last_error", bg_err->stringRefSelf(), nullptr);
+        }
+    }
+    return rv.release();
+}
+
+int QoreV8ProgramPool::create(ExceptionSink* xsink, unsigned idx, bool first) {
+    assert(!entries[idx].obj);
+    int64 start = q_clock_getmicros();
+
+    ReferenceHolder<QoreV8ProgramData> jsp(snapshot
+        ? new QoreV8ProgramData(snapshot, xsink, &dir)
+        : new QoreV8ProgramData(source, label, xsink, &dir), xsink);
+    if (*xsink) {
+        return -1;
+    }
+    QoreV8ProgramData* pgm = *jsp;
+    // the pool must be set before the initialization code is run, so the program can be mapped to the pool
+    pgm->setPool(this, idx, first);
+    ReferenceHolder<QoreObject> obj(new QoreObject(QC_JAVASCRIPTPROGRAM, getProgram(), jsp.release()), xsink);
+    pgm->setObject(*obj);
+
+    if (init) {
+        ReferenceHolder<QoreListNode> args(new QoreListNode(autoTypeInfo), xsink);
+        args->push(obj->refSelf(), xsink);
+        ValueHolder rv(init->execValue(*args, xsink), xsink);
+        if (*xsink) {
+            pgm->setPool(nullptr, 0, false);
+            return -1;
+        }
+    }
+
+    entries[idx].pgm = pgm;
+    entries[idx].obj = obj.release();
+    entries[idx].last_used.store(q_clock_getmicros());
+    ++live;
+    ++creates;
+    create_us += q_clock_getmicros() - start;
+    return 0;
+}
+
+void QoreV8ProgramPool::destroy(ExceptionSink* xsink, unsigned idx) {
+    QoreObject* obj = entries[idx].obj;
+    assert(obj);
+    entries[idx].pgm->setPool(nullptr, 0, false);
+    entries[idx].pgm = nullptr;
+    entries[idx].obj = nullptr;
+    --live;
+    ++evictions;
+    obj->deref(xsink);
+
+    empty_stack.push(entries.get(), idx);
+    signalWaiters();
+}
+
+void QoreV8ProgramPool::pushFree(unsigned idx) {
+    free_stack.push(entries.get(), idx);
+    ++free_count;
+    signalWaiters();
+}
+
+void QoreV8ProgramPool::signalWaiters() {
+    // a waiting thread increments the counter before checking the stacks with the lock held, so it is either
+    // already waiting on the condition or will find the entry just pushed
+    if (waiting.load()) {
+        AutoLocker al(m);
+        cond.signal();
+    }
+}
+
+void QoreV8ProgramPool::checkSpare() {
+    if (free_count.load() < (int)spare && live.load() < (int)max) {
+        AutoLocker al(m);
+        if (!bg_wakeup && !bg_failed) {
+            bg_wakeup = true;
+            bg_cond.signal();
+        }
+    }
+}
+
+void QoreV8ProgramPool::background_thread(ExceptionSink* xsink, void* arg) {
+    QoreV8ProgramPool* pool = reinterpret_cast<QoreV8ProgramPool*>(arg);
+    pool->backgroundThread(xsink);
+    pool->deref(xsink);
+}
+
+void QoreV8ProgramPool::backgroundThread(ExceptionSink* xsink) {
+    // check at least once a second, or more often with short idle timeouts
+    int interval = 1000;
+    if (idle_timeout_ms && idle_timeout_ms < 2000) {
+        interval = idle_timeout_ms < 20 ? 10 : (int)(idle_timeout_ms / 2);
+    }
+
+    {
+        AutoLocker al(m);
+        bg_tid = q_gettid();
+    }
+
+    while (true) {
+        {
+            AutoLocker al(m);
+            if (!bg_stop && !bg_wakeup) {
+                bg_cond.wait(&m, interval);
+            }
+            bg_wakeup = false;
+            if (bg_stop) {
+                break;
+            }
+        }
+
+        if (!bg_failed) {
+            prewarm(xsink);
+        }
+        evict(xsink);
+
+        if (*xsink) {
+            ++errors;
+            QoreValue desc = xsink->getExceptionDesc();
+            QoreStringNodeMaker* err = new QoreStringNodeMaker("%s", desc.getType() == NT_STRING
+                ? desc.get<const QoreStringNode>()->c_str() : "unknown error");
+            xsink->clear();
+            AutoLocker al(m);
+            if (bg_err) {
+                bg_err->deref();
+            }
+            bg_err = err;
+            bg_failed = true;
+        }
+    }
+
+    AutoLocker al(m);
+    bg_running = false;
+    bg_tid = -1;
+    bg_cond.broadcast();
+}
+
+void QoreV8ProgramPool::prewarm(ExceptionSink* xsink) {
+    while (true) {
+        {
+            AutoLocker al(m);
+            if (bg_stop) {
+                return;
+            }
+        }
+        int l = live.load();
+        if (l >= (int)min && free_count.load() >= (int)spare) {
+            return;
+        }
+        int idx = empty_stack.pop(entries.get());
+        if (idx < 0) {
+            return;
+        }
+        if (create(xsink, idx)) {
+            empty_stack.push(entries.get(), idx);
+            signalWaiters();
+            return;
+        }
+        pushFree(idx);
+    }
+}
+
+void QoreV8ProgramPool::evict(ExceptionSink* xsink) {
+    if (!idle_timeout_ms) {
+        return;
+    }
+    unsigned floor = min > spare ? min : spare;
+    if (live.load() <= (int)floor) {
+        return;
+    }
+
+    int64 cutoff = q_clock_getmicros() - idle_timeout_ms * 1000;
+    std::vector<unsigned> idle;
+    std::vector<unsigned>::size_type n;
+    {
+        // the lock is held while the free programs are off of the stack, so a get() call that finds the stack
+        // empty waits for the lock in its slow path instead of creating an extra program
+        AutoLocker al(m);
+        // take the free programs off of the stack; the most recently used are at the top
+        std::vector<unsigned> keep;
+        int idx;
+        while ((idx = free_stack.pop(entries.get())) >= 0) {
+            --free_count;
+            if (entries[idx].last_used.load() < cutoff) {
+                idle.push_back(idx);
+            } else {
+                keep.push_back(idx);
+            }
+        }
+
+        // select the least recently used idle programs to destroy while keeping the pool at the floor size
+        int excess = live.load() - (int)floor;
+        n = excess > 0 ? (std::vector<unsigned>::size_type)excess : 0;
+        if (n > idle.size()) {
+            n = idle.size();
+        }
+        // idle programs that are kept are less recently used than all the other programs
+        keep.insert(keep.end(), idle.begin(), idle.end() - n);
+
+        // restore the remaining programs in their original order before destroying any programs
+        for (std::vector<unsigned>::reverse_iterator i = keep.rbegin(), e = keep.rend(); i != e; ++i) {
+            free_stack.push(entries.get(), *i);
+            ++free_count;
+        }
+        if (!keep.empty() && waiting.load()) {
+            cond.broadcast();
+        }
+    }
+
+    for (std::vector<unsigned>::iterator i = idle.end() - n, e = idle.end(); i != e; ++i) {
+        destroy(xsink, *i);
+    }
+}
@@ -0,0 +1,186 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+    QoreV8ProgramPool.h
+
+    Qore Programming Language
+
+    Copyright (C) 2024 Qore Technologies, s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+    DEALINGS IN THE SOFTWARE.
+
+    Note that the Qore library is released under a choice of three open-source
+    licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+    information.
+*/
+
+
+#ifndef _QORE_QOREV8PROGRAMPOOL
+
+#define _QORE_QOREV8PROGRAMPOOL
+
+#include "v8-module.h"
+#include "QoreV8Snapshot.h"
+
+#include <atomic>
+#include <memory>
+
+class QoreV8Program;
+
+//! Pool of JavaScriptProgram objects created from the same source
+/** Free programs are kept on a lock-free stack, so acquiring and releasing a program does not take a lock unless the
+    pool is exhausted.  A background thread pre-warms the pool to the minimum size, keeps spare programs available
+    so that new programs are not created on the request path, and evicts programs that have been idle for too long.
+*/
+class QoreV8ProgramPool : public AbstractPrivateData {
+public:
+    //! Creates the pool and the initial program
+    DLLLOCAL QoreV8ProgramPool(ExceptionSink* xsink, QoreObject* self, const QoreString& source_code,
+            const QoreString& source_label, const ResolvedCallReferenceNode* init, const QoreHashNode* opts);
+
+    //! Stops the background thread and releases all programs
+    DLLLOCAL void destructor(ExceptionSink* xsink);
+
+    //! Acquires a program from the pool; timeout_ms < 0 means wait indefinitely
+    DLLLOCAL QoreObject* get(ExceptionSink* xsink, int64 timeout_ms = -1);
+
+    //! Returns a program to the pool
+    DLLLOCAL int release(ExceptionSink* xsink, QoreV8Program* pgm);
+
+    //! Returns the number of programs in the pool
+    DLLLOCAL int size() const {
+        return live.load();
+    }
+
+    //! Returns pool statistics
+    DLLLOCAL QoreHashNode* getStats() const;
+
+    //! Returns the pool object with a new reference
+    DLLLOCAL QoreObject* getReferencedObject() const {
+        return self->objectRefSelf();
+    }
+
+    //! Returns the pool object for the given program with a new reference
+    DLLLOCAL static QoreObject* getPool(ExceptionSink* xsink, QoreV8Program* pgm);
+
+protected:
+    //! tagged index value for an empty stack
+    static constexpr uint32_t NONE = 0;
+
+    struct entry_t {
+        // the JavaScriptProgram object; nullptr if the slot is empty
+        QoreObject* obj = nullptr;
+        // the program data for the object
+        QoreV8Program* pgm = nullptr;
+        // the next entry in the stack + 1; NONE = end of stack
+        std::atomic<uint32_t> next = {NONE};
+        // the time the program was last released in microseconds
+        std::atomic<int64> last_used = {0};
+        // true if the program has been acquired
+        std::atomic<bool> in_use = {false};
+    };
+
+    //! Lock-free stack of entry indexes; the upper 32 bits of the head are a tag that prevents ABA issues
+    class IndexStack {
+    public:
+        DLLLOCAL void push(entry_t* entries, unsigned idx);
+        DLLLOCAL int pop(entry_t* entries);
+
+    private:
+        std::atomic<uint64_t> head = {NONE};
+    };
+
+    QoreObject* self;
+    QoreString source;
+    QoreString label;
+    // the base directory for require()
+    QoreString dir;
+    // the optional snapshot for creating programs
+    QoreV8Snapshot* snapshot = nullptr;
+    // the optional initialization code for new programs
+    ResolvedCallReferenceNode* init = nullptr;
+
+    unsigned min = 1;
+    unsigned max = 64;
+    unsigned spare = 0;
+    int64 idle_timeout_ms = 0;
+
+    std::unique_ptr<entry_t[]> entries;
+    // programs available to be acquired
+    IndexStack free_stack;
+    // slots without a program
+    IndexStack empty_stack;
+
+    std::atomic<int> live = {0};
+    std::atomic<int> free_count = {0};
+    std::atomic<int> waiting = {0};
+
+    // statistics
+    mutable std::atomic<int64> hits = {0},
+        creates = {0},
+        create_us = {0},
+        evictions = {0},
+        waits = {0},
+        wait_us = {0},
+        max_wait_us = {0},
+        timeouts = {0},
+        errors = {0};
+
+    // lock and conditions for waiting when the pool is exhausted and for the background thread
+    mutable QoreThreadLock m;
+    QoreCondition cond;
+    QoreCondition bg_cond;
+    // the last error from the background thread
+    QoreStringNode* bg_err = nullptr;
+    int bg_tid = -1;
+    bool bg_running = false;
+    bool bg_stop = false;
+    bool bg_wakeup = false;
+    // set when creating a program in the background fails; cleared when a program is acquired
+    std::atomic<bool> bg_failed = {false};
+
+    DLLLOCAL virtual ~QoreV8ProgramPool();
+
+    //! Creates a new program in the given slot
+    DLLLOCAL int create(ExceptionSink* xsink, unsigned idx, bool first = false);
+
+    //! Destroys the program in the given slot and returns the slot to the empty stack
+    DLLLOCAL void destroy(ExceptionSink* xsink, unsigned idx);
+
+    //! Returns a program to the free stack and wakes up any waiting threads
+    DLLLOCAL void pushFree(unsigned idx);
+
+    //! Wakes up threads waiting for a program
+    DLLLOCAL void signalWaiters();
+
+    //! Wakes up the background thread if more programs are needed
+    DLLLOCAL void checkSpare();
+
+    //! Background thread main loop
+    DLLLOCAL void backgroundThread(ExceptionSink* xsink);
+
+    //! Creates programs up to the minimum size and the number of spare programs
+    DLLLOCAL void prewarm(ExceptionSink* xsink);
+
+    //! Destroys programs that have been idle longer than the idle timeout
+    DLLLOCAL void evict(ExceptionSink* xsink);
+
+    DLLLOCAL static void background_thread(ExceptionSink* xsink, void* arg);
+};
+
+#endif
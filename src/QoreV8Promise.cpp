@@ -31,6 +31,7 @@
 
 #include "QoreV8Promise.h"
 #include "QoreV8Program.h"
+#include "QC_JavaScriptPromise.h"
 
 #include <uv.h>
 
@@ -42,16 +43,200 @@ v8::Local<v8::Promise> QoreV8Promise::get() const {
     return v8::Local<v8::Promise>::Cast(obj.Get(pgm->getIsolate()));
 }
 
-int QoreV8Promise::wait(QoreV8ProgramHelper& v8h) {
+// the maximum time in milliseconds to block in the event loop backend before checking the Promise state again;
+// Promises can also be settled by other threads while the isolate lock is released
+static constexpr int QV8_PROMISE_POLL_MS = 50;
+
+int QoreV8Promise::wait(QoreV8ProgramHelper& v8h, int64 timeout_ms) {
+    return waitUntil(v8h, [this] () -> bool { return get()->State() != v8::Promise::kPending; }, timeout_ms);
+}
+
+int QoreV8Promise::waitUntil(QoreV8ProgramHelper& v8h, const std::function<bool()>& done, int64 timeout_ms) {
     v8::Isolate* isolate = v8h.getIsolate();
-    v8::Local<v8::Promise> p = get();
-    while (p->State() == v8::Promise::kPending) {
-        v8h.getProgram()->spinOnce();
+    uv_loop_t* loop = v8h.getProgram()->getEventLoop();
+    int64 deadline = timeout_ms > 0 ? q_clock_getmicros() + timeout_ms * 1000 : 0;
+
+    while (true) {
+        // dispatch ready callbacks and microtasks with the isolate lock held
         isolate->PerformMicrotaskCheckpoint();
+        if (done()) {
+            break;
+        }
+
+        // if the loop is owned by an event loop thread, wait for it to run the loop instead
+        QoreV8EventLoop* el = v8h.getProgram()->getEventLoopThread();
+        if (el && el->inLoopThread()) {
+            el = nullptr;
+        }
+
+        int poll_ms = QV8_PROMISE_POLL_MS;
+        if (!el) {
+            bool alive = uv_run(loop, UV_RUN_NOWAIT);
+            isolate->PerformMicrotaskCheckpoint();
+            if (done()) {
+                break;
+            }
+            if (alive) {
+                int backend_ms = uv_backend_timeout(loop);
+                if (backend_ms >= 0 && backend_ms < poll_ms) {
+                    poll_ms = backend_ms;
+                }
+            }
+        }
+        if (deadline) {
+            int64 remaining = deadline - q_clock_getmicros();
+            if (remaining <= 0) {
+                v8h.getExceptionSink()->raiseException("PROMISE-TIMEOUT", "timeout waiting " QLLD " ms for "
+                    "Promises to be settled", timeout_ms);
+                return -1;
+            }
+            // round up to the next millisecond
+            remaining = (remaining + 999) / 1000;
+            if (remaining < poll_ms) {
+                poll_ms = (int)remaining;
+            }
+        }
+
+        // release the isolate lock while blocked so that other threads can use the program
+        if (el) {
+            // the pass counter is only incremented with the isolate lock held, so no pass can be missed
+            int64 pass = el->getPass();
+            v8::Unlocker unlocker(isolate);
+            el->waitPass(pass, poll_ms);
+        } else if (poll_ms) {
+            v8::Unlocker unlocker(isolate);
+            QoreV8EventLoop::pollBackend(loop, poll_ms);
+        }
     }
     return 0;
 }
 
+// holds references to Promise private data
+class QoreV8PromiseList : public std::vector<QoreV8Promise*> {
+public:
+    DLLLOCAL QoreV8PromiseList(ExceptionSink* xsink) : xsink(xsink) {
+    }
+
+    DLLLOCAL ~QoreV8PromiseList() {
+        for (QoreV8Promise* p : *this) {
+            p->deref(xsink);
+        }
+    }
+
+private:
+    ExceptionSink* xsink;
+};
+
+// returns a settlement record for a settled Promise
+static QoreHashNode* get_settlement(QoreV8ProgramHelper& v8h, v8::Local<v8::Promise> p, int index = -1) {
+    ExceptionSink* xsink = v8h.getExceptionSink();
+    ValueHolder v(v8h.getProgram()->getQoreValue(xsink, p->Result()), xsink);
+    if (*xsink) {
+        return nullptr;
+    }
+    ReferenceHolder<QoreHashNode> rv(new QoreHashNode(autoTypeInfo), xsink);
+    if (index >= 0) {
+        rv->setKeyValue("index", index, xsink);
+    }
+    rv->setKeyValue("state", (int64)p->State(), xsink);
+    rv->setKeyValue("value", v.release(), xsink);
+    return rv.release();
+}
+
+QoreValue QoreV8Promise::waitMany(ExceptionSink* xsink, const QoreListNode* l, qv8_promise_wait_e mode,
+        int64 timeout_ms) {
+    // get the Promise private data for all list elements
+    QoreV8PromiseList pv(xsink);
+    pv.reserve(l->size());
+    QoreV8Program* pgm = nullptr;
+    for (size_t i = 0, e = l->size(); i < e; ++i) {
+        QoreValue v = l->retrieveEntry(i);
+        QoreV8Promise* p = nullptr;
+        if (v.getType() == NT_OBJECT) {
+            p = v.get<const QoreObject>()->tryGetReferencedPrivateData<QoreV8Promise>(CID_JAVASCRIPTPROMISE, xsink);
+            if (*xsink) {
+                return QoreValue();
+            }
+        }
+        if (!p) {
+            xsink->raiseException("PROMISE-WAIT-ERROR", "list element %zu has type '%s'; expecting "
+                "'JavaScriptPromise'", i, v.getFullTypeName());
+            return QoreValue();
+        }
+        pv.push_back(p);
+        if (!pgm) {
+            pgm = p->getProgram();
+        } else if (p->getProgram() != pgm) {
+            xsink->raiseException("PROMISE-WAIT-ERROR", "list element %zu belongs to a different JavaScriptProgram "
+                "than the first element; all Promises must belong to the same program", i);
+            return QoreValue();
+        }
+    }
+
+    if (pv.empty()) {
+        return mode == QV8_WAIT_ANY ? QoreValue() : QoreValue(new QoreListNode(autoTypeInfo));
+    }
+
+    QoreV8ProgramHelper v8h(xsink, pgm);
+    if (*xsink) {
+        return QoreValue();
+    }
+
+    if (waitUntil(v8h, [&pv, mode] () -> bool {
+            bool all = true;
+            for (QoreV8Promise* p : pv) {
+                v8::Promise::PromiseState state = p->get()->State();
+                if (state == v8::Promise::kPending) {
+                    all = false;
+                } else if (mode == QV8_WAIT_ANY || (mode == QV8_WAIT_ALL && state == v8::Promise::kRejected)) {
+                    return true;
+                }
+            }
+            return all;
+        }, timeout_ms)) {
+        return QoreValue();
+    }
+
+    if (mode == QV8_WAIT_ANY) {
+        for (size_t i = 0, e = pv.size(); i < e; ++i) {
+            v8::Local<v8::Promise> p = pv[i]->get();
+            if (p->State() != v8::Promise::kPending) {
+                return get_settlement(v8h, p, (int)i);
+            }
+        }
+        assert(false);
+        return QoreValue();
+    }
+
+    ReferenceHolder<QoreListNode> rv(new QoreListNode(autoTypeInfo), xsink);
+    for (size_t i = 0, e = pv.size(); i < e; ++i) {
+        v8::Local<v8::Promise> p = pv[i]->get();
+        if (mode == QV8_WAIT_SETTLED) {
+            QoreHashNode* h = get_settlement(v8h, p);
+            if (!h) {
+                return QoreValue();
+            }
+            rv->push(h, xsink);
+            continue;
+        }
+        if (p->State() == v8::Promise::kRejected) {
+            ValueHolder reason(pgm->getQoreValue(xsink, p->Result()), xsink);
+            if (*xsink) {
+                return QoreValue();
+            }
+            xsink->raiseExceptionArg("PROMISE-REJECTED", reason.release(), new QoreStringNodeMaker("Promise %zu in "
+                "the list was rejected; the rejection value is provided as the exception argument", i));
+            return QoreValue();
+        }
+        ValueHolder v(pgm->getQoreValue(xsink, p->Result()), xsink);
+        if (*xsink) {
+            return QoreValue();
+        }
+        rv->push(v.release(), xsink);
+    }
+    return rv.release();
+}
+
 QoreValue QoreV8Promise::getResult(QoreV8ProgramHelper& v8h) {
     v8::Local<v8::Promise> p = get();
     ExceptionSink* xsink = v8h.getExceptionSink();
@@ -194,7 +379,9 @@ v8::Promise::PromiseState QoreV8Promise::getState(QoreV8ProgramHelper& v8h) {
 }
 
 static void deref_callref(const v8::WeakCallbackInfo<QoreV8PromiseCallbackInfo>& data) {
-    delete data.GetParameter();
+    QoreV8PromiseCallbackInfo* cbinfo = data.GetParameter();
+    cbinfo->func.Reset();
+    delete cbinfo;
 }
 
 v8::MaybeLocal<v8::Function> QoreV8Promise::getPromiseFunction(QoreV8ProgramHelper& v8h,
@@ -207,13 +394,9 @@ v8::MaybeLocal<v8::Function> QoreV8Promise::getPromiseFunction(QoreV8ProgramHelp
     v8::EscapableHandleScope handle_scope(isolate);
     const v8::TryCatch tryCatch(isolate);
 
-    QoreV8PromiseCallbackInfo* cbinfo = new QoreV8PromiseCallbackInfo(call, v8h.getProgram(), get());
-    v8::Local<v8::External> ext = v8::External::New(isolate, (void*)cbinfo);
-
-    // add callback to external object
-    v8::Global<v8::External> gext;
-    gext.Reset(isolate, ext);
-    gext.SetWeak(cbinfo, deref_callref, v8::WeakCallbackType::kParameter);
+    std::unique_ptr<QoreV8PromiseCallbackInfo> cbinfo(new QoreV8PromiseCallbackInfo(call, v8h.getProgram(),
+        get()));
+    v8::Local<v8::External> ext = v8::External::New(isolate, (void*)cbinfo.get());
 
     v8::Local<v8::Context> context = v8h.getContext();
     v8::MaybeLocal<v8::Function> func = v8::Function::New(context, call_wrapper, ext);
@@ -224,11 +407,17 @@ v8::MaybeLocal<v8::Function> QoreV8Promise::getPromiseFunction(QoreV8ProgramHelp
         }
         return v8::MaybeLocal<v8::Function>();
     }
-    if (v8h.getProgram()->saveQoreReference(call->refSelf(), *xsink)) {
+    if (v8h.getProgram()->saveQoreReference(const_cast<ResolvedCallReferenceNode*>(call), func.ToLocalChecked(),
+            *xsink)) {
         //printd(5, "call: %p -> cannot save Qore reference\n", call);
         assert(*xsink);
         return v8::MaybeLocal<v8::Function>();
     }
+
+    // the weak handle is kept in the callback info, which is deleted when the function is collected
+    cbinfo->func.Reset(isolate, func.ToLocalChecked());
+    cbinfo->func.SetWeak(cbinfo.get(), deref_callref, v8::WeakCallbackType::kParameter);
+    cbinfo.release();
     //printd(5, "call: %p -> returning JS function object\n", call);
     return v8::MaybeLocal<v8::Function>(handle_scope.Escape(func.ToLocalChecked()));
 }
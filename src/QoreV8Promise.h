@@ -35,6 +35,18 @@
 
 #include "QoreV8Object.h"
 
+#include <functional>
+
+//! Conditions for waiting on many Promises
+enum qv8_promise_wait_e {
+    //! wait for all Promises to be fulfilled or any to be rejected
+    QV8_WAIT_ALL = 0,
+    //! wait for any Promise to be settled
+    QV8_WAIT_ANY = 1,
+    //! wait for all Promises to be settled
+    QV8_WAIT_SETTLED = 2,
+};
+
 class QoreV8Promise : public QoreV8Object {
 public:
     DLLLOCAL QoreV8Promise(ExceptionSink* xsink, QoreV8Program* pgm, v8::Local<v8::Promise> obj);
@@ -44,7 +56,36 @@ public:
 
     DLLLOCAL v8::Local<v8::Promise> get() const;
 
-    DLLLOCAL int wait(QoreV8ProgramHelper& v8h);
+    //! Waits for the Promise to be settled while running the program's event loop
+    /** The isolate lock is released while blocked waiting for I/O
+
+        @param v8h the program helper
+        @param timeout_ms the maximum time to wait in milliseconds; if 0 or negative, waits indefinitely
+
+        @return 0 for OK, -1 if the timeout expired, in which case a \c PROMISE-TIMEOUT exception is raised
+    */
+    DLLLOCAL int wait(QoreV8ProgramHelper& v8h, int64 timeout_ms = 0);
+
+    //! Waits for the given condition while running the program's event loop
+    /** @param v8h the program helper
+        @param done returns true when the wait is complete; called with the isolate lock held
+        @param timeout_ms the maximum time to wait in milliseconds; if 0 or negative, waits indefinitely
+
+        @return 0 for OK, -1 if the timeout expired, in which case a \c PROMISE-TIMEOUT exception is raised
+    */
+    DLLLOCAL static int waitUntil(QoreV8ProgramHelper& v8h, const std::function<bool()>& done,
+            int64 timeout_ms = 0);
+
+    //! Waits for a list of JavaScriptPromise objects in a single pass over the program's event loop
+    /** @param xsink for %Qore exceptions
+        @param l the list of JavaScriptPromise objects; all Promises must belong to the same program
+        @param mode the condition to wait for
+        @param timeout_ms the maximum time to wait in milliseconds; if 0 or negative, waits indefinitely
+
+        @return the results according to \a mode
+    */
+    DLLLOCAL static QoreValue waitMany(ExceptionSink* xsink, const QoreListNode* l, qv8_promise_wait_e mode,
+            int64 timeout_ms);
 
     DLLLOCAL v8::MaybeLocal<v8::Promise> then(QoreV8ProgramHelper& v8h, const ResolvedCallReferenceNode* code,
             const ResolvedCallReferenceNode* rejected);
@@ -66,6 +107,8 @@ struct QoreV8PromiseCallbackInfo {
     ResolvedCallReferenceNode* ref;
     QoreV8Program* pgm;
     v8::Global<v8::Promise> promise;
+    //! weak reference to the function; the info is deleted when the function is collected
+    v8::Global<v8::Function> func;
 
     DLLLOCAL QoreV8PromiseCallbackInfo(const ResolvedCallReferenceNode* ref, QoreV8Program* pgm,
             v8::Local<v8::Promise> promise);
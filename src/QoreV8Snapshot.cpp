@@ -0,0 +1,170 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+    QoreV8Snapshot.cpp
+
+    Qore Programming Language
+
+    Copyright (C) 2024 Qore Technologies, s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+    DEALINGS IN THE SOFTWARE.
+
+    Note that the Qore library is released under a choice of three open-source
+    licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+    information.
+*/
+
+
+#include "QoreV8Snapshot.h"
+#include "QoreV8Program.h"
+
+#include <vector>
+#include <string>
+
+QoreV8Snapshot::QoreV8Snapshot(const QoreString& source_code, const QoreString& source_label,
+        ExceptionSink* xsink) : label(source_label) {
+    if (checkSupported(xsink)) {
+        return;
+    }
+#ifdef QORE_V8_HAVE_SNAPSHOTS
+    assert(source_code.getEncoding() == QCS_UTF8);
+    assert(source_label.getEncoding() == QCS_UTF8);
+
+    int64 start = q_clock_getmicros();
+
+    std::vector<std::string> errors;
+    std::unique_ptr<node::CommonEnvironmentSetup> setup =
+        node::CommonEnvironmentSetup::CreateForSnapshotting(platform.get(), &errors, init_result->args(),
+            init_result->exec_args());
+    if (!setup) {
+        SimpleRefHolder<QoreStringNode> desc(new QoreStringNode("could not create snapshotting environment: "));
+        for (const std::string& err : errors) {
+            desc->concat(err.c_str());
+            desc->concat("; ");
+        }
+        xsink->raiseException("JAVASCRIPT-SNAPSHOT-ERROR", desc.release());
+        return;
+    }
+
+    v8::Isolate* isolate = setup->isolate();
+    {
+        v8::Locker locker(isolate);
+        v8::Isolate::Scope isolate_scope(isolate);
+        v8::HandleScope handle_scope(isolate);
+        v8::Context::Scope context_scope(setup->context());
+        v8::TryCatch tryCatch(isolate);
+
+        // only the built-in require() is available while building the snapshot; the public require() is created
+        // relative to the current working directory when each program is deserialized
+        v8::MaybeLocal<v8::Value> loadenv_ret = node::LoadEnvironment(setup->env(),
+            "globalThis.require = require;\n"
+            "require('v8').startupSnapshot.setDeserializeMainFunction(() => {\n"
+            "    globalThis.require = require('module').createRequire(process.cwd() + '/');\n"
+            "});\n");
+        if (loadenv_ret.IsEmpty()) {
+            if (!QoreV8Program::checkException(xsink, isolate, tryCatch)) {
+                xsink->raiseException("JAVASCRIPT-SNAPSHOT-ERROR", "Unknown error initializing snapshot "
+                    "environment");
+            }
+            node::Stop(setup->env());
+            return;
+        }
+
+        // the code cache is not used, as compiled code is included in the snapshot
+        if (QoreV8Program::runSource(xsink, isolate, setup->context(), source_code, source_label, tryCatch,
+                false)) {
+            node::Stop(setup->env());
+            return;
+        }
+
+        // run any pending operations to completion before the environment is serialized
+        if (node::SpinEventLoop(setup->env()).IsNothing()) {
+            if (!QoreV8Program::checkException(xsink, isolate, tryCatch)) {
+                xsink->raiseException("JAVASCRIPT-SNAPSHOT-ERROR", "Unknown error running event loop for snapshot");
+            }
+            node::Stop(setup->env());
+            return;
+        }
+
+        data = setup->CreateSnapshot();
+        node::Stop(setup->env());
+    }
+
+    if (!data) {
+        xsink->raiseException("JAVASCRIPT-SNAPSHOT-ERROR", "Node.js could not create a startup snapshot for '%s'",
+            source_label.c_str());
+        return;
+    }
+
+    create_us = q_clock_getmicros() - start;
+#endif
+}
+
+QoreV8Snapshot::QoreV8Snapshot(const BinaryNode* blob, const QoreString& source_label, ExceptionSink* xsink)
+        : label(source_label) {
+    if (checkSupported(xsink)) {
+        return;
+    }
+#ifdef QORE_V8_HAVE_SNAPSHOTS
+    int64 start = q_clock_getmicros();
+
+    const char* p = reinterpret_cast<const char*>(blob->getPtr());
+    std::vector<char> in(p, p + blob->size());
+    data = node::EmbedderSnapshotData::FromBlob(in);
+    if (!data) {
+        xsink->raiseException("JAVASCRIPT-SNAPSHOT-ERROR", "the given snapshot data (" QLLD " bytes) is invalid or "
+            "was created by a different version of Node.js", (int64)blob->size());
+        return;
+    }
+
+    create_us = q_clock_getmicros() - start;
+#endif
+}
+
+BinaryNode* QoreV8Snapshot::toBinary(ExceptionSink* xsink) const {
+#ifdef QORE_V8_HAVE_SNAPSHOTS
+    assert(data);
+    std::vector<char> blob = data->ToBlob();
+    SimpleRefHolder<BinaryNode> rv(new BinaryNode);
+    if (rv->append(blob.data(), blob.size())) {
+        xsink->outOfMemory();
+        return nullptr;
+    }
+    return rv.release();
+#else
+    checkSupported(xsink);
+    return nullptr;
+#endif
+}
+
+bool QoreV8Snapshot::isSupported() {
+#ifdef QORE_V8_HAVE_SNAPSHOTS
+    return node::EmbedderSnapshotData::CanUseCustomSnapshotPerIsolate();
+#else
+    return false;
+#endif
+}
+
+int QoreV8Snapshot::checkSupported(ExceptionSink* xsink) {
+    if (!isSupported()) {
+        xsink->raiseException("JAVASCRIPT-SNAPSHOT-ERROR", "the Node.js library in use does not support custom "
+            "startup snapshots; Node.js 20+ built without the shared read-only heap is required");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+    QoreV8Snapshot.h
+
+    Qore Programming Language
+
+    Copyright (C) 2024 Qore Technologies, s.r.o.
+
+    Permission is hereby granted, free of charge, to any person obtaining a
+    copy of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom the
+    Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+    DEALINGS IN THE SOFTWARE.
+
+    Note that the Qore library is released under a choice of three open-source
+    licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+    information.
+*/
+
+
+#ifndef _QORE_QOREV8SNAPSHOT
+
+#define _QORE_QOREV8SNAPSHOT
+
+#include "v8-module.h"
+
+//! Startup snapshot of a Node.js environment after the program source has been run
+/** Programs created from the snapshot are deserialized from the blob instead of bootstrapping Node.js and running
+    the source again.
+
+    The snapshot data must stay valid as long as any isolate created from it exists, so programs created from the
+    snapshot hold a reference to this object.
+*/
+class QoreV8Snapshot : public AbstractPrivateData {
+public:
+    //! Creates the snapshot by running the given source in a snapshotting environment
+    DLLLOCAL QoreV8Snapshot(const QoreString& source_code, const QoreString& source_label, ExceptionSink* xsink);
+
+    //! Creates the snapshot from a blob previously returned by toBinary()
+    DLLLOCAL QoreV8Snapshot(const BinaryNode* blob, const QoreString& source_label, ExceptionSink* xsink);
+
+    //! Returns the serialized snapshot
+    DLLLOCAL BinaryNode* toBinary(ExceptionSink* xsink) const;
+
+    //! Returns the source label
+    DLLLOCAL const QoreString& getLabel() const {
+        return label;
+    }
+
+    //! Returns the time in microseconds it took to create the snapshot
+    DLLLOCAL int64 getCreationTime() const {
+        return create_us;
+    }
+
+#ifdef QORE_V8_HAVE_SNAPSHOTS
+    //! Returns the snapshot data for creating new environments
+    DLLLOCAL const node::EmbedderSnapshotData* get() const {
+        return data.get();
+    }
+#endif
+
+    //! Returns true if custom startup snapshots can be used with the current Node.js library
+    DLLLOCAL static bool isSupported();
+
+protected:
+#ifdef QORE_V8_HAVE_SNAPSHOTS
+    node::EmbedderSnapshotData::Pointer data;
+#endif
+    QoreString label;
+    int64 create_us = 0;
+
+    DLLLOCAL virtual ~QoreV8Snapshot() {
+    }
+
+    DLLLOCAL static int checkSupported(ExceptionSink* xsink);
+};
+
+#endif
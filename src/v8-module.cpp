@@ -24,7 +24,10 @@
 #include "QC_JavaScriptProgram.h"
 #include "QC_JavaScriptObject.h"
 #include "QC_JavaScriptPromise.h"
+#include "QC_JavaScriptSnapshot.h"
+#include "QC_JavaScriptProgramPool.h"
 #include "QoreV8Program.h"
+#include "QoreV8CodeCache.h"
 
 //static std::unique_ptr<v8::Platform> platform;
 std::unique_ptr<node::MultiIsolatePlatform> platform;
@@ -90,6 +93,7 @@ static sig_vec_t sig_vec = {
 
 static void v8_module_shutdown() {
     //printd(5, "v8_module_shutdown()\n");
+    QoreV8AsyncWorkerPool::shutdown();
     QoreV8Program::shutdown();
 
     v8::V8::Dispose();
@@ -107,9 +111,11 @@ static QoreStringNode* v8_module_init_intern(qore_module_init_info& info, bool r
     if (!V8NS) {
         V8NS = new QoreNamespace("V8");
         preinitJavaScriptObjectClass();
+        V8NS->addSystemClass(initJavaScriptSnapshotClass(*V8NS));
         V8NS->addSystemClass(initJavaScriptProgramClass(*V8NS));
         V8NS->addSystemClass(initJavaScriptObjectClass(*V8NS));
         V8NS->addSystemClass(initJavaScriptPromiseClass(*V8NS));
+        V8NS->addSystemClass(initJavaScriptProgramPoolClass(*V8NS));
     }
 
     const char* argv0 = info.path.c_str();
@@ -143,6 +149,15 @@ static QoreStringNode* v8_module_init_intern(qore_module_init_info& info, bool r
     v8::V8::InitializePlatform(platform.get());
     v8::V8::Initialize();
 
+    // set the persistent code cache directory, if any; an invalid directory is ignored
+    const char* cache_dir = getenv("QORE_V8_CODE_CACHE_DIR");
+    if (cache_dir && *cache_dir) {
+        ExceptionSink xsink;
+        if (QoreV8CodeCache::setDir(cache_dir, &xsink)) {
+            xsink.clear();
+        }
+    }
+
     //printd(5, "v8_module_init_intern()\n");
     return nullptr;
 }
@@ -46,6 +46,11 @@
 //! the name of the language in stack traces
 #define QORE_V8_LANG_NAME "V8"
 
+// startup snapshots for embedders are available in Node.js 20+
+#if NODE_MAJOR_VERSION >= 20
+#define QORE_V8_HAVE_SNAPSHOTS 1
+#endif
+
 // module registration function
 DLLEXPORT extern "C" void v8_qore_module_desc(QoreModuleInfo& mod_info);
 